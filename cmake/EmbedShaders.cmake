@@ -0,0 +1,32 @@
+# Writes every shaders/*.glsl into a C++ header as string data, so the
+# executable does not read shaders from the working directory.
+#
+#   cmake -DSHADER_DIR=<dir> -DOUTPUT=<header> -P EmbedShaders.cmake
+#
+# The header is only touched when its contents change.
+
+get_filename_component(SHADER_DIR ${SHADER_DIR} ABSOLUTE)
+file(GLOB shaders RELATIVE ${SHADER_DIR} ${SHADER_DIR}/*.glsl)
+list(SORT shaders)
+
+set(entries "")
+foreach(name IN LISTS shaders)
+    file(READ ${SHADER_DIR}/${name} source)
+    string(APPEND entries "    {\"${name}\", R\"glsl(${source})glsl\"},\n")
+endforeach()
+
+file(WRITE ${OUTPUT}.tmp
+"#pragma once
+// Generated from shaders/*.glsl by cmake/EmbedShaders.cmake; do not edit.
+#include <string_view>
+
+struct EmbeddedShader {
+    std::string_view name;
+    std::string_view source;
+};
+
+inline constexpr EmbeddedShader EMBEDDED_SHADERS[] = {
+${entries}};
+")
+file(COPY_FILE ${OUTPUT}.tmp ${OUTPUT} ONLY_IF_DIFFERENT)
+file(REMOVE ${OUTPUT}.tmp)
@@ -0,0 +1,12 @@
+#version 330 core
+layout(location = 0) in vec2 aXZ;      // offset from the grid origin, static
+layout(location = 1) in float aHeight; // potential sag, streamed per frame
+
+uniform mat4 model;
+#include "camera.glsl"
+uniform vec3 gridOrigin; // relative to the camera
+
+void main() {
+    vec3 pos = gridOrigin + vec3(aXZ.x, aHeight, aXZ.y);
+    gl_Position = viewProjection * model * vec4(pos, 1.0);
+}
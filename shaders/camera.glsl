@@ -0,0 +1,10 @@
+// Shared by every scene shader; filled once per frame by CameraBuffer.
+// Positions are drawn relative to the camera, so `view` is only its
+// rotation. The camera's world position is double precision on the CPU
+// and never reaches the shaders.
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 depthMapping; // window depth = ndc z * x + y
+};
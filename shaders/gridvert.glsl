@@ -1,10 +1,17 @@
 #version 330 core
-layout(location = 0) in vec3 aPos;
+layout(location = 0) in vec2 aSlot;    // ring slot (column, row), static
+layout(location = 1) in float aHeight; // potential sag, streamed per frame
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "camera.glsl"
+uniform vec3 gridOrigin; // relative to the camera
+uniform vec2 gridOffset; // ring scroll in slots
+uniform float gridCount;
+uniform float gridSpacing;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    // Undo the ring scroll to find which lattice line this slot holds
+    vec2 cell = mod(aSlot - gridOffset + gridCount, gridCount);
+    vec2 xz = gridOrigin.xz + (cell - 0.5 * gridCount) * gridSpacing;
+    gl_Position = viewProjection * model * vec4(xz.x, gridOrigin.y + aHeight, xz.y, 1.0);
+}
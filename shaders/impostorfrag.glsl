@@ -0,0 +1,40 @@
+#version 330 core
+
+in vec3 vViewPos;
+flat in vec3 vCenter;
+flat in float vRadius;
+flat in vec3 vColor;
+flat in float vIsSun;
+out vec4 FragColor;
+
+#include "camera.glsl"
+uniform vec3 lightPos; // star position in view space
+
+void main()
+{
+    // Eye ray through this fragment against the sphere
+    vec3 dir = normalize(vViewPos);
+    float b = dot(dir, vCenter);
+    float disc = b * b - (dot(vCenter, vCenter) - vRadius * vRadius);
+    if (disc < 0.0)
+    discard;
+
+    float t = b - sqrt(disc);
+    vec3 hit = dir * t;
+    vec3 normal = (hit - vCenter) / vRadius;
+
+    vec4 clip = projection * vec4(hit, 1.0);
+    gl_FragDepth = (clip.z / clip.w) * depthMapping.x + depthMapping.y;
+
+    vec3 color;
+    if (vIsSun > 0.5) {
+        // Emissive, brighter towards the middle of the disc
+        float facing = max(dot(normal, -dir), 0.0);
+        color = vColor + vec3(1.0, 0.9, 0.7) * facing * facing;
+    } else {
+        float diffuse = max(dot(normal, normalize(lightPos - hit)), 0.0);
+        color = vColor * (0.15 + 0.85 * diffuse);
+    }
+
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 330 core
+
+// Per instance, same layout as pvShader.glsl
+layout (location = 1) in mat4 aModel;     // locations 1-4
+layout (location = 5) in vec4 aColorSize; // rgb, point size (unused)
+layout (location = 6) in float aIsSun;
+
+#include "camera.glsl"
+
+out vec3 vViewPos;              // quad point in view space, on the ray
+flat out vec3 vCenter;          // sphere center in view space
+flat out float vRadius;
+flat out vec3 vColor;
+flat out float vIsSun;
+
+void main()
+{
+    vec3 center = (view * aModel[3]).xyz;
+    float radius = length(aModel[0].xyz);
+
+    // Quad on the plane through the sphere's nearest point, big enough to
+    // hold the eye's projection of the sphere's bounding cube onto it.
+    float zf = min(center.z + radius, -1e-3);
+    float back = zf / (center.z - radius);
+    vec2 lo = min(center.xy - radius, (center.xy - radius) * back);
+    vec2 hi = max(center.xy + radius, (center.xy + radius) * back);
+
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vViewPos = vec3(mix(lo, hi, corner), zf);
+    vCenter = center;
+    vRadius = radius;
+    vColor = aColorSize.rgb;
+    vIsSun = aIsSun;
+
+    gl_Position = projection * vec4(vViewPos, 1.0);
+}
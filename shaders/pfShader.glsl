@@ -1,11 +1,9 @@
 #version 330 core
 
-in vec3 vColor;
+flat in vec3 vColor;
+flat in float vIsSun;
 out vec4 FragColor;
 
-uniform vec3 baseColor;
-uniform float isSun;
-
 void main()
 {
     // Make each point a circle
@@ -17,9 +15,9 @@ void main()
     float r = sqrt(r2);
     float edge = smoothstep(1.0, 0.7, 1.0 - r);
 
-    vec3 color = mix(vColor, baseColor, 0.6);
+    vec3 color = vColor;
 
-    if (isSun > 0.5) {
+    if (vIsSun > 0.5) {
         // Soft radial glow
         float glow = pow(1.0 - clamp(r, 0.0, 1.0), 2.0);
         color += vec3(1.0, 0.9, 0.7) * glow;
@@ -1,20 +1,23 @@
 #version 330 core
 
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aColor;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform float pointSize;
+// Per instance
+layout (location = 1) in mat4 aModel;     // locations 1-4
+layout (location = 5) in vec4 aColorSize; // rgb, point size
+layout (location = 6) in float aIsSun;
 
-out vec3 vColor;
+#include "camera.glsl"
+
+flat out vec3 vColor;
+flat out float vIsSun;
 
 void main()
 {
-    vec4 worldPos = model * vec4(aPos, 1.0);
-    vColor = aColor;
+    vec4 worldPos = aModel * vec4(aPos, 1.0);
+    vColor = aColorSize.rgb;
+    vIsSun = aIsSun;
 
-    gl_Position = projection * view * worldPos;
-    gl_PointSize = pointSize;
+    gl_Position = viewProjection * worldPos;
+    gl_PointSize = aColorSize.a;
 }
@@ -0,0 +1,10 @@
+#version 330 core
+
+in float vAge;
+out vec4 FragColor;
+
+uniform vec3 trailColor;
+
+void main() {
+    FragColor = vec4(trailColor, 0.6 * (1.0 - vAge));
+}
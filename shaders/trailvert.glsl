@@ -0,0 +1,28 @@
+#version 330 core
+
+// Two vertices per segment, segment = slot * trailBodies + body, joining
+// that body's samples in `slot` and the slot after it.
+uniform samplerBuffer trailPositions; // per slot: x block, y block, z block
+uniform int trailBodies;
+uniform int trailSlots;
+uniform int trailHead;   // slot of the newest sample
+uniform int trailFilled; // slots holding samples
+uniform vec3 trailOrigin; // where samples are measured from, relative to the camera
+
+#include "camera.glsl"
+
+out float vAge; // 0 at the newest sample, 1 at the oldest
+
+void main() {
+    int segment = gl_VertexID / 2;
+    int body = segment % trailBodies;
+    int slot = (segment / trailBodies + (gl_VertexID & 1)) % trailSlots;
+
+    int base = slot * 3 * trailBodies + body;
+    vec3 pos = vec3(texelFetch(trailPositions, base).r,
+                    texelFetch(trailPositions, base + trailBodies).r,
+                    texelFetch(trailPositions, base + 2 * trailBodies).r);
+
+    vAge = float((trailHead - slot + trailSlots) % trailSlots) / float(trailFilled - 1);
+    gl_Position = viewProjection * vec4(trailOrigin + pos, 1.0);
+}
@@ -0,0 +1,302 @@
+#include "AdaptiveGrid.h"
+#include <algorithm>
+#include <cmath>
+#include "ThreadPool.h"
+
+namespace {
+
+// A source whose bound on a cell is below this share of the tolerance is
+// folded into a running total instead of being tested against every
+// descendant; the total shrinks 4x per level like each term would.
+constexpr float FAR_FRACTION = 1.0f / 64.0f;
+constexpr size_t VERTICES_PER_TASK = 512;
+// A cell split last frame stays split until its bound drops below this
+// share of the tolerance, so a body drifting along a cell boundary doesn't
+// flip the topology every frame.
+constexpr float MERGE_FRACTION = 0.5f;
+
+constexpr uint64_t COORD_MASK = (1ull << 28) - 1;
+
+uint64_t leafKey(int level, uint64_t x, uint64_t z) {
+    return static_cast<uint64_t>(level) << 56 | x << 28 | z;
+}
+
+uint64_t vertexKey(uint64_t x, uint64_t z) {
+    return x << 32 | z;
+}
+
+} // namespace
+
+AdaptiveGrid::AdaptiveGrid(float size, int minDepth, int maxDepth, float tolerance)
+        : size(size),
+          minDepth(minDepth),
+          maxDepth(std::min(maxDepth, 27)),
+          tolerance(tolerance),
+          origin(0.0f, 0.0f, 0.0f)
+{
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &xzVBO);
+    glGenBuffers(1, &EBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, xzVBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBindVertexArray(0);
+}
+
+void AdaptiveGrid::setOrigin(const glm::vec3 &newOrigin) {
+    origin = glm::vec3(newOrigin.x, 0.0f, newOrigin.z);
+}
+
+void AdaptiveGrid::update(const std::vector<Grid::GravitySource> &newSources) {
+    sources = newSources;
+    const size_t count = sources.size();
+
+    useTree = openingAngle > 0.0f && count >= GRID_TREE_MIN_SOURCES;
+    if (useTree) {
+        treePositions.resize(count);
+        treeMasses.resize(count);
+        for (size_t s = 0; s < count; ++s) {
+            treePositions[s] = sources[s].position;
+            treeMasses[s] = sources[s].mass;
+        }
+        tree.build(treePositions, treeMasses);
+    }
+
+    leaves.clear();
+    refinedKeys.clear();
+    splitKeys.clear();
+    std::vector<uint32_t> all(count);
+    for (size_t s = 0; s < count; ++s) all[s] = static_cast<uint32_t>(s);
+    refine({0, 0, 0}, all, 0.0f);
+    lastSplitKeys.swap(splitKeys);
+
+    // Balancing and topology follow from the refined leaves alone, which
+    // refine() always visits in the same order, so while the bodies stay in
+    // their cells only the heights are recomputed and streamed.
+    if (refinedKeys != lastRefinedKeys) {
+        lastRefinedKeys.swap(refinedKeys);
+        balance();
+        buildTopology();
+    }
+    computeHeights();
+
+    // The vertex count follows the refinement, so regions grow with headroom
+    size_t bytes = heights.size() * sizeof(float);
+    if (bytes > heightStream.regionBytes()) heightStream.create(GL_ARRAY_BUFFER, bytes + bytes / 2);
+
+    float *mapped = static_cast<float *>(heightStream.begin());
+    std::copy(heights.begin(), heights.end(), mapped);
+    size_t offset = heightStream.end();
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, heightStream.id());
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)offset);
+    glBindVertexArray(0);
+}
+
+// Upper bound on how far the potential of one source can stray from a
+// straight line across the cell: |d2U/dx2| <= 2 G m / d^3 over the cell, times
+// h^2 / 8 for linear interpolation, rounded up to G m h^2 / d^3.
+float AdaptiveGrid::cellBound(const Cell &cell, uint32_t source) const {
+    const Grid::GravitySource &src = sources[source];
+    float h = size / static_cast<float>(1u << cell.level);
+    float px = src.position.x - origin.x + 0.5f * size;
+    float pz = src.position.z - origin.z + 0.5f * size;
+    float x0 = cell.x * h, z0 = cell.z * h;
+
+    float dx = std::max(0.0f, std::max(x0 - px, px - (x0 + h)));
+    float dz = std::max(0.0f, std::max(z0 - pz, pz - (z0 + h)));
+    float d2 = dx * dx + dz * dz + src.position.y * src.position.y + GRID_SOFTENING * GRID_SOFTENING;
+    return GRID_G * src.mass * h * h / (d2 * std::sqrt(d2));
+}
+
+void AdaptiveGrid::refine(const Cell &cell, const std::vector<uint32_t> &near, float farBound) {
+    float far = farBound;
+    float bound = farBound;
+    std::vector<uint32_t> stillNear;
+    stillNear.reserve(near.size());
+    for (uint32_t s : near) {
+        float b = cellBound(cell, s);
+        bound += b;
+        if (b < tolerance * FAR_FRACTION) far += b;
+        else stillNear.push_back(s);
+    }
+
+    const uint64_t key = leafKey(cell.level, cell.x, cell.z);
+    const float threshold = lastSplitKeys.count(key) ? tolerance * MERGE_FRACTION : tolerance;
+    bool split = cell.level < minDepth || (cell.level < maxDepth && bound > threshold);
+    if (!split) {
+        leaves.push_back(cell);
+        refinedKeys.push_back(key);
+        return;
+    }
+    splitKeys.insert(key);
+    for (uint32_t c = 0; c < 4; ++c) {
+        Cell child{cell.level + 1, cell.x * 2 + (c & 1), cell.z * 2 + (c >> 1)};
+        refine(child, stillNear, far * 0.25f);
+    }
+}
+
+bool AdaptiveGrid::hasLeaf(int level, long x, long z) const {
+    return leafKeys.count(leafKey(level, static_cast<uint64_t>(x), static_cast<uint64_t>(z))) != 0;
+}
+
+// Splits leaves until no two edge neighbours differ by more than one level,
+// so a leaf edge has at most one extra vertex in its middle.
+void AdaptiveGrid::balance() {
+    leafKeys.clear();
+    for (const Cell &c : leaves) leafKeys.insert(leafKey(c.level, c.x, c.z));
+
+    std::vector<Cell> queue = leaves;
+    const long offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+    while (!queue.empty()) {
+        Cell c = queue.back();
+        queue.pop_back();
+        if (!hasLeaf(c.level, c.x, c.z)) continue;
+
+        const long extent = 1L << c.level;
+        bool splitAny = false;
+        for (const auto &o : offsets) {
+            long nx = static_cast<long>(c.x) + o[0];
+            long nz = static_cast<long>(c.z) + o[1];
+            if (nx < 0 || nz < 0 || nx >= extent || nz >= extent) continue;
+
+            for (int l = c.level - 2; l >= 0; --l) {
+                int shift = c.level - l;
+                long lx = nx >> shift, lz = nz >> shift;
+                if (!hasLeaf(l, lx, lz)) continue;
+
+                leafKeys.erase(leafKey(l, lx, lz));
+                for (uint32_t k = 0; k < 4; ++k) {
+                    Cell child{l + 1, static_cast<uint32_t>(lx * 2 + (k & 1)), static_cast<uint32_t>(lz * 2 + (k >> 1))};
+                    leafKeys.insert(leafKey(child.level, child.x, child.z));
+                    queue.push_back(child);
+                }
+                splitAny = true;
+                break;
+            }
+        }
+        // A neighbour split once may still be too coarse, so look again
+        if (splitAny) queue.push_back(c);
+    }
+
+    leaves.clear();
+    for (uint64_t key : leafKeys) {
+        leaves.push_back({static_cast<int>(key >> 56),
+                          static_cast<uint32_t>((key >> 28) & COORD_MASK),
+                          static_cast<uint32_t>(key & COORD_MASK)});
+    }
+}
+
+// Rebuilds vertices and line indices for the balanced leaves.
+void AdaptiveGrid::buildTopology() {
+    std::vector<uint64_t> keys;
+    keys.reserve(leaves.size());
+    for (const Cell &c : leaves) keys.push_back(leafKey(c.level, c.x, c.z));
+    std::sort(keys.begin(), keys.end());
+
+    vertexIds.clear();
+    vertexCells.clear();
+    auto vertex = [this](uint64_t x, uint64_t z) {
+        uint64_t key = vertexKey(x, z);
+        auto it = vertexIds.emplace(key, static_cast<uint32_t>(vertexCells.size()));
+        if (it.second) vertexCells.push_back(key);
+    };
+
+    for (uint64_t key : keys) {
+        int level = static_cast<int>(key >> 56);
+        uint64_t s = 1ull << (maxDepth - level);
+        uint64_t x0 = ((key >> 28) & COORD_MASK) * s, z0 = (key & COORD_MASK) * s;
+        vertex(x0, z0);
+        vertex(x0 + s, z0);
+        vertex(x0, z0 + s);
+        vertex(x0 + s, z0 + s);
+    }
+
+    // Neighbouring leaves share edges, so dedupe by endpoint pair.
+    edgeKeys.clear();
+    indices.clear();
+    for (uint64_t key : keys) {
+        int level = static_cast<int>(key >> 56);
+        uint32_t s = 1u << (maxDepth - level);
+        uint64_t x0 = ((key >> 28) & COORD_MASK) * s, z0 = (key & COORD_MASK) * s;
+        emitEdge(vertexKey(x0, z0), vertexKey(x0 + s, z0), s);
+        emitEdge(vertexKey(x0, z0), vertexKey(x0, z0 + s), s);
+        emitEdge(vertexKey(x0 + s, z0), vertexKey(x0 + s, z0 + s), s);
+        emitEdge(vertexKey(x0, z0 + s), vertexKey(x0 + s, z0 + s), s);
+    }
+
+    const float finest = size / static_cast<float>(1u << maxDepth);
+    std::vector<float> xz;
+    xz.reserve(vertexCells.size() * 2);
+    for (uint64_t key : vertexCells) {
+        xz.push_back((key >> 32) * finest - 0.5f * size);
+        xz.push_back((key & 0xffffffffu) * finest - 0.5f * size);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, xzVBO);
+    glBufferData(GL_ARRAY_BUFFER, xz.size() * sizeof(float), xz.data(), GL_STATIC_DRAW);
+    glBindVertexArray(VAO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    indexCount = static_cast<int>(indices.size());
+    heights.resize(vertexCells.size());
+}
+
+// One leaf edge from a to b (finest-lattice keys), cut at any vertex a finer
+// neighbour put in its middle.
+void AdaptiveGrid::emitEdge(uint64_t a, uint64_t b, uint32_t length) {
+    if (length > 1) {
+        uint64_t mid = vertexKey(((a >> 32) + (b >> 32)) / 2, ((a & 0xffffffffu) + (b & 0xffffffffu)) / 2);
+        if (vertexIds.count(mid)) {
+            emitEdge(a, mid, length / 2);
+            emitEdge(mid, b, length / 2);
+            return;
+        }
+    }
+    uint32_t ia = vertexIds[a], ib = vertexIds[b];
+    uint64_t edge = static_cast<uint64_t>(std::min(ia, ib)) << 32 | std::max(ia, ib);
+    if (!edgeKeys.insert(edge).second) return;
+    indices.push_back(ia);
+    indices.push_back(ib);
+}
+
+void AdaptiveGrid::computeHeights() {
+    const float finest = size / static_cast<float>(1u << maxDepth);
+    const float soft2 = GRID_SOFTENING * GRID_SOFTENING;
+    const glm::vec3 corner = origin - glm::vec3(0.5f * size, 0.0f, 0.5f * size);
+
+    ThreadPool::global().parallelFor(vertexCells.size(), VERTICES_PER_TASK, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            uint64_t key = vertexCells[v];
+            glm::vec3 p = corner + glm::vec3((key >> 32) * finest, 0.0f, (key & 0xffffffffu) * finest);
+            if (useTree) {
+                heights[v] = -GRID_G * tree.potential(p, openingAngle, soft2);
+                continue;
+            }
+            float dip = 0.0f;
+            for (const auto &src : sources) {
+                glm::vec3 d = p - src.position;
+                dip += -GRID_G * src.mass / std::sqrt(glm::dot(d, d) + soft2);
+            }
+            heights[v] = dip;
+        }
+    });
+}
+
+void AdaptiveGrid::draw(Shader &shader, const glm::dvec3 &eye)
+{
+    if (uniformShader != &shader) {
+        originUniform = shader.uniform<glm::vec3>("gridOrigin");
+        uniformShader = &shader;
+    }
+    shader.set(originUniform, glm::vec3(glm::dvec3(origin) - eye));
+    glBindVertexArray(VAO);
+    glDrawElements(GL_LINES, indexCount, GL_UNSIGNED_INT, 0);
+    heightStream.fence();
+}
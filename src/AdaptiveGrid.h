@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Shader.h"
+#include "Grid.h"
+#include "PotentialTree.h"
+#include "StreamBuffer.h"
+
+// Potential sag on a quadtree instead of a uniform lattice. Cells split
+// while the linear-interpolation error bound of the potential across them,
+// sum G m h^2 / d^3, is above `tolerance`, so vertices pile up near the
+// masses and stay sparse over flat regions. Leaves are kept 2:1 balanced and
+// every leaf edge is split at the vertices of its finer neighbours, so the
+// lines have no T-junction cracks.
+class AdaptiveGrid {
+public:
+    // `size` is the edge length of the square; cells go from
+    // size / 2^minDepth down to size / 2^maxDepth.
+    AdaptiveGrid(float size, int minDepth, int maxDepth, float tolerance);
+
+    void update(const std::vector<Grid::GravitySource> &sources);
+    // `eye` is the camera's world position; the grid is drawn relative to it.
+    void draw(Shader &shader, const glm::dvec3 &eye);
+
+    // Center of the square in world space (x,z). y is always 0.
+    void setOrigin(const glm::vec3 &newOrigin);
+    void setOpeningAngle(float theta) { openingAngle = theta; }
+
+    size_t vertexCount() const { return vertexCells.size(); }
+
+private:
+    struct Cell {
+        int level;
+        uint32_t x, z; // in cells of this level
+    };
+
+    void refine(const Cell &cell, const std::vector<uint32_t> &near, float farBound);
+    float cellBound(const Cell &cell, uint32_t source) const;
+    void balance();
+    bool hasLeaf(int level, long x, long z) const;
+    void buildTopology();
+    void emitEdge(uint64_t a, uint64_t b, uint32_t length);
+    void computeHeights();
+
+    float size;
+    int minDepth, maxDepth;
+    float tolerance;
+    glm::vec3 origin;
+
+    GLuint VAO, xzVBO, EBO;
+    StreamBuffer heightStream;
+    const Shader *uniformShader = nullptr; // shader originUniform is for
+    Uniform<glm::vec3> originUniform;
+    int indexCount = 0;
+
+    std::vector<Grid::GravitySource> sources;
+    std::vector<Cell> leaves;
+    std::unordered_set<uint64_t> leafKeys;
+    std::vector<uint64_t> refinedKeys;     // refine() output, in visit order
+    std::vector<uint64_t> lastRefinedKeys; // last frame's, to detect topology changes
+    std::unordered_set<uint64_t> splitKeys, lastSplitKeys; // cells refine() split
+
+    // Vertices on the finest lattice, (x, z) packed into one key
+    std::unordered_map<uint64_t, uint32_t> vertexIds;
+    std::vector<uint64_t> vertexCells;
+    std::unordered_set<uint64_t> edgeKeys;
+    std::vector<GLuint> indices;
+    std::vector<float> heights;
+
+    float openingAngle = 0.5f;
+    bool useTree = false;
+    PotentialTree tree;
+    std::vector<glm::vec3> treePositions;
+    std::vector<float> treeMasses;
+};
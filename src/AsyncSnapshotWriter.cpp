@@ -0,0 +1,127 @@
+#include "AsyncSnapshotWriter.h"
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+constexpr size_t STAGING_ALIGNMENT = 4096;
+}
+
+AsyncSnapshotWriter::~AsyncSnapshotWriter() {
+    close();
+}
+
+bool AsyncSnapshotWriter::open(const std::string &path, const BodyAttributes &attributes,
+                               uint32_t stepStride, const SnapshotEncodingOptions &encoding,
+                               int stagingBuffers) {
+    close();
+    if (!writer.open(path, attributes, stepStride, encoding)) return false;
+    return start(stagingBuffers);
+}
+
+bool AsyncSnapshotWriter::resume(const std::string &path, const BodyAttributes &attributes,
+                                 uint32_t stepStride, const SnapshotEncodingOptions &encoding,
+                                 uint64_t step, int stagingBuffers) {
+    close();
+    if (!writer.resume(path, attributes, stepStride, encoding, step)) return false;
+    return start(stagingBuffers);
+}
+
+// Allocates the staging buffers and starts the I/O thread for the open writer.
+bool AsyncSnapshotWriter::start(int stagingBuffers) {
+    // Round up to whole pages so every flush is one aligned write.
+    size_t bytes = writer.chunkBytes();
+    size_t capacity = (bytes + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+
+    staging.resize(stagingBuffers > 1 ? stagingBuffers : 2);
+    for (size_t i = 0; i < staging.size(); ++i) {
+        void *data = nullptr;
+        if (posix_memalign(&data, STAGING_ALIGNMENT, capacity) != 0) {
+            std::cerr << "Could not allocate snapshot staging buffers\n";
+            freeStaging();
+            writer.close();
+            return false;
+        }
+        staging[i].data = data;
+        staging[i].bytes = bytes;
+        freeList.push_back(static_cast<int>(i));
+    }
+
+    stopping = false;
+    failed = false;
+    stallCount = 0;
+    ioThread = std::thread(&AsyncSnapshotWriter::run, this);
+    return true;
+}
+
+bool AsyncSnapshotWriter::submit(uint64_t step, double time, const BodyColumns &columns) {
+    if (!isOpen()) return false;
+    if (columns.size() != writer.bodies()) {
+        std::cerr << "Snapshot body count changed mid-run (" << columns.size()
+                  << " vs " << writer.bodies() << ")\n";
+        return false;
+    }
+
+    int slot;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (failed) return false;
+        if (freeList.empty()) {
+            ++stallCount;
+            freeReady.wait(lock, [this] { return !freeList.empty() || failed; });
+            if (failed) return false;
+        }
+        slot = freeList.front();
+        freeList.pop_front();
+    }
+
+    SnapshotWriter::encodeChunk(step, time, columns, staging[slot].data);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.push_back(slot);
+    }
+    pendingReady.notify_one();
+    return true;
+}
+
+void AsyncSnapshotWriter::run() {
+    for (;;) {
+        int slot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            pendingReady.wait(lock, [this] { return !pending.empty() || stopping; });
+            if (pending.empty()) return; // stopping and fully drained
+            slot = pending.front();
+            pending.pop_front();
+        }
+
+        bool ok = writer.writeChunk(staging[slot].data, staging[slot].bytes);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeList.push_back(slot);
+            if (!ok) failed = true;
+        }
+        freeReady.notify_one();
+    }
+}
+
+void AsyncSnapshotWriter::close() {
+    if (ioThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        pendingReady.notify_one();
+        ioThread.join();
+    }
+    writer.close();
+    freeStaging();
+}
+
+void AsyncSnapshotWriter::freeStaging() {
+    for (auto &s : staging) std::free(s.data);
+    staging.clear();
+    freeList.clear();
+    pending.clear();
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Snapshot.h"
+
+// Moves snapshot I/O off the simulation thread. submit() copies the columns
+// into a free staging buffer and returns; a dedicated thread writes each
+// staged chunk to disk with a single write. The staging buffers are
+// page-aligned, but the file is written through the page cache at whatever
+// offset the chunk falls on. When every staging buffer is still queued (the
+// disk is behind), submit() blocks until one is returned, so memory use
+// stays bounded. Quantized encoding also runs on the I/O thread.
+class AsyncSnapshotWriter {
+public:
+    AsyncSnapshotWriter() = default;
+    ~AsyncSnapshotWriter();
+
+    AsyncSnapshotWriter(const AsyncSnapshotWriter &) = delete;
+    AsyncSnapshotWriter &operator=(const AsyncSnapshotWriter &) = delete;
+
+    bool open(const std::string &path, const BodyAttributes &attributes,
+              uint32_t stepStride, const SnapshotEncodingOptions &encoding = {},
+              int stagingBuffers = 3);
+
+    // As open(), but continues the file of a restarted run; see
+    // SnapshotWriter::resume.
+    bool resume(const std::string &path, const BodyAttributes &attributes,
+                uint32_t stepStride, const SnapshotEncodingOptions &encoding, uint64_t step,
+                int stagingBuffers = 3);
+
+    bool submit(uint64_t step, double time, const BodyColumns &columns);
+
+    // Drains pending chunks, stops the I/O thread and finalizes the file.
+    void close();
+
+    bool isOpen() const { return writer.isOpen(); }
+    bool due(uint64_t step) const { return writer.due(step); }
+
+    // Number of submit() calls that had to wait for the I/O thread.
+    uint64_t stalls() const { return stallCount; }
+
+private:
+    struct Staging {
+        void *data = nullptr;
+        size_t bytes = 0;
+    };
+
+    bool start(int stagingBuffers);
+    void run();
+    void freeStaging();
+
+    SnapshotWriter writer;
+    std::vector<Staging> staging;
+
+    std::mutex mutex;
+    std::condition_variable pendingReady; // signalled when work is queued
+    std::condition_variable freeReady;    // signalled when a buffer is returned
+    std::deque<int> freeList;
+    std::deque<int> pending;
+    bool stopping = false;
+    bool failed = false;
+
+    uint64_t stallCount = 0;
+    std::thread ioThread;
+};
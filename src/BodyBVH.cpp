@@ -0,0 +1,149 @@
+#include "BodyBVH.h"
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+constexpr uint32_t LEAF_SIZE = 4;
+
+// Frustum planes (a, b, c, d) with inside where ax + by + cz + d >= 0,
+// read off the rows of the combined matrix.
+void frustumPlanes(const glm::mat4 &m, glm::vec4 planes[6]) {
+    glm::vec4 row[4];
+    for (int r = 0; r < 4; ++r) row[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+    planes[0] = row[3] + row[0];
+    planes[1] = row[3] - row[0];
+    planes[2] = row[3] + row[1];
+    planes[3] = row[3] - row[1];
+    planes[4] = row[3] + row[2];
+    planes[5] = row[3] - row[2];
+    // An infinite projection has no far plane; the row difference for it
+    // comes out as (0, 0, 0, d > 0), which every point is inside.
+    for (int p = 0; p < 6; ++p) {
+        float length = glm::length(glm::vec3(planes[p]));
+        planes[p] = length > 0.0f ? planes[p] / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+}
+
+} // namespace
+
+void BodyBVH::update(const std::vector<glm::vec4> &spheres) {
+    if (spheres.size() != order.size() || ++refits >= REBUILD_INTERVAL) {
+        build(spheres);
+    } else {
+        refit(spheres);
+    }
+}
+
+void BodyBVH::build(const std::vector<glm::vec4> &spheres) {
+    refits = 0;
+    nodes.clear();
+    order.resize(spheres.size());
+    std::iota(order.begin(), order.end(), 0u);
+    if (spheres.empty()) return;
+    nodes.reserve(2 * spheres.size() / LEAF_SIZE + 1);
+    buildNode(spheres, 0, static_cast<uint32_t>(spheres.size()));
+}
+
+// Median split along the widest axis of the centers.
+uint32_t BodyBVH::buildNode(const std::vector<glm::vec4> &spheres, uint32_t begin, uint32_t end) {
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({});
+
+    glm::vec3 lo(INFINITY), hi(-INFINITY), centerLo(INFINITY), centerHi(-INFINITY);
+    for (uint32_t i = begin; i < end; ++i) {
+        const glm::vec4 &s = spheres[order[i]];
+        glm::vec3 c(s);
+        lo = glm::min(lo, c - s.w);
+        hi = glm::max(hi, c + s.w);
+        centerLo = glm::min(centerLo, c);
+        centerHi = glm::max(centerHi, c);
+    }
+
+    Node node{lo, hi, begin, end - begin};
+    if (end - begin > LEAF_SIZE) {
+        glm::vec3 extent = centerHi - centerLo;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        uint32_t mid = begin + (end - begin) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                         [&](uint32_t a, uint32_t b) { return spheres[a][axis] < spheres[b][axis]; });
+
+        buildNode(spheres, begin, mid);
+        node.first = buildNode(spheres, mid, end);
+        node.count = 0;
+    }
+    nodes[index] = node;
+    return index;
+}
+
+// Children come after their parent, so one backward pass is bottom-up.
+void BodyBVH::refit(const std::vector<glm::vec4> &spheres) {
+    for (size_t n = nodes.size(); n-- > 0;) {
+        Node &node = nodes[n];
+        if (node.count > 0) {
+            glm::vec3 lo(INFINITY), hi(-INFINITY);
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                const glm::vec4 &s = spheres[order[i]];
+                lo = glm::min(lo, glm::vec3(s) - s.w);
+                hi = glm::max(hi, glm::vec3(s) + s.w);
+            }
+            node.lo = lo;
+            node.hi = hi;
+        } else {
+            const Node &left = nodes[n + 1];
+            const Node &right = nodes[node.first];
+            node.lo = glm::min(left.lo, right.lo);
+            node.hi = glm::max(left.hi, right.hi);
+        }
+    }
+}
+
+void BodyBVH::cull(const std::vector<glm::vec4> &spheres, const glm::mat4 &viewProjection,
+                   std::vector<uint32_t> &visible) const {
+    visible.clear();
+    if (nodes.empty()) return;
+
+    glm::vec4 planes[6];
+    frustumPlanes(viewProjection, planes);
+
+    // Each entry carries the planes its box is not yet known to be inside
+    struct Entry { uint32_t node; uint32_t mask; };
+    std::vector<Entry> stack;
+    stack.push_back({0, 0x3f});
+
+    while (!stack.empty()) {
+        Entry e = stack.back();
+        stack.pop_back();
+        const Node &node = nodes[e.node];
+
+        glm::vec3 center = 0.5f * (node.lo + node.hi);
+        glm::vec3 half = 0.5f * (node.hi - node.lo);
+        uint32_t mask = e.mask;
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; ++p) {
+            if (!(mask & (1u << p))) continue;
+            const glm::vec4 &pl = planes[p];
+            float dist = glm::dot(glm::vec3(pl), center) + pl.w;
+            float reach = glm::dot(glm::abs(glm::vec3(pl)), half);
+            if (dist < -reach) outside = true;
+            else if (dist >= reach) mask &= ~(1u << p);
+        }
+        if (outside) continue;
+
+        if (node.count == 0) {
+            stack.push_back({e.node + 1, mask});
+            stack.push_back({node.first, mask});
+        } else {
+            // Boxes of a few spheres are loose, so test the spheres themselves
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                const glm::vec4 &s = spheres[order[i]];
+                bool inside = true;
+                for (int p = 0; p < 6 && inside; ++p) {
+                    if (mask & (1u << p)) inside = glm::dot(planes[p], glm::vec4(glm::vec3(s), 1.0f)) >= -s.w;
+                }
+                if (inside) visible.push_back(order[i]);
+            }
+        }
+    }
+    std::sort(visible.begin(), visible.end());
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Bounding volume hierarchy over body bounding spheres for frustum culling.
+// The tree is built once and refitted bottom-up every frame as bodies move;
+// it is rebuilt from scratch when the body count changes or every
+// REBUILD_INTERVAL refits, before the boxes have loosened too far.
+class BodyBVH {
+public:
+    static constexpr int REBUILD_INTERVAL = 120;
+
+    // spheres[i] = (center, radius) of body i
+    void update(const std::vector<glm::vec4> &spheres);
+
+    // Replaces `visible` with the bodies whose sphere touches the frustum of
+    // `viewProjection`, in ascending order. `spheres` is the last update's.
+    void cull(const std::vector<glm::vec4> &spheres, const glm::mat4 &viewProjection,
+              std::vector<uint32_t> &visible) const;
+
+private:
+    struct Node {
+        glm::vec3 lo, hi;
+        uint32_t first; // leaf: first index in `order`; inner: right child
+        uint32_t count; // bodies in a leaf, 0 for inner nodes (left child
+                        // is the next node)
+    };
+
+    void build(const std::vector<glm::vec4> &spheres);
+    uint32_t buildNode(const std::vector<glm::vec4> &spheres, uint32_t begin, uint32_t end);
+    void refit(const std::vector<glm::vec4> &spheres);
+
+    std::vector<Node> nodes;     // parents before children
+    std::vector<uint32_t> order; // body indices, grouped by leaf
+    int refits = 0;
+};
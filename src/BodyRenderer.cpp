@@ -0,0 +1,134 @@
+#include "BodyRenderer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace {
+constexpr size_t MIN_CAPACITY = 64;
+
+// A ring of S points looks solid up to a circumference of about 2S pixels,
+// so a mesh with S segments serves projected radii up to S / pi.
+constexpr float PIXELS_PER_SEGMENT = 1.0f / 3.14159265f;
+// Below this projected radius a body is drawn as one sprite.
+constexpr float POINT_RADIUS = 1.5f;
+// A body only changes level once it is this far past the boundary.
+constexpr float HYSTERESIS = 0.15f;
+}
+
+BodyRenderer::BodyRenderer(int segments, int rings) {
+    for (int s = segments, r = rings; s >= MIN_SEGMENTS; s /= 2, r = std::max(2, r / 2)) {
+        const SphereMesh &mesh = SphereMesh::get(s, r);
+        levels.push_back({makeVAO(mesh.vbo()), mesh.vertexCount(), s * PIXELS_PER_SEGMENT});
+    }
+    if (!levels.empty()) levels.front().maxRadius = INFINITY;
+
+    // One point at the center
+    const float origin[3] = {0.0f, 0.0f, 0.0f};
+    glGenBuffers(1, &pointVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, pointVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(origin), origin, GL_STATIC_DRAW);
+    levels.push_back({makeVAO(pointVBO), 1, POINT_RADIUS});
+
+    // Impostor corners come from gl_VertexID, so only instance attributes
+    impostorVAO = makeVAO(0);
+}
+
+GLuint BodyRenderer::makeVAO(GLuint meshVBO) {
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    if (meshVBO) {
+        glBindBuffer(GL_ARRAY_BUFFER, meshVBO);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+
+    // Model matrix columns (1-4), color + point size (5), isSun (6)
+    for (GLuint i = 1; i <= 6; ++i) {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+    glBindVertexArray(0);
+    return vao;
+}
+
+BodyInstance *BodyRenderer::beginFrame(const std::vector<uint32_t> &bodies, size_t bodyCount) {
+    if (bodyLevel.size() != bodyCount) bodyLevel.assign(bodyCount, 0);
+    stagedBodies = bodies;
+    staged.resize(bodies.size());
+    return staged.data();
+}
+
+// Coarsest level whose range holds `pixels`, kept at `current` unless the
+// radius is clearly past the boundary.
+uint8_t BodyRenderer::chooseLevel(float pixels, uint8_t current) const {
+    auto ideal = [this](float r) {
+        uint8_t level = static_cast<uint8_t>(levels.size() - 1);
+        while (level > 0 && r > levels[level].maxRadius) --level;
+        return level;
+    };
+    uint8_t target = ideal(pixels);
+    if (target < current && ideal(pixels / (1.0f + HYSTERESIS)) < current) return target;
+    if (target > current && ideal(pixels * (1.0f + HYSTERESIS)) > current) return target;
+    return current;
+}
+
+void BodyRenderer::draw(const glm::mat4 &view, const glm::mat4 &projection, float viewportHeight) {
+    const size_t count = staged.size();
+    // Nothing visible (or no bodies at all); the stream may not exist yet
+    if (count == 0) return;
+    if (count > capacity) {
+        capacity = std::max(MIN_CAPACITY, count + count / 2);
+        instances.create(GL_ARRAY_BUFFER, capacity * sizeof(BodyInstance));
+    }
+    auto *out = static_cast<BodyInstance *>(instances.begin());
+
+    if (impostors) {
+        std::copy(staged.begin(), staged.end(), out);
+        const size_t base = instances.end();
+        pointInstances(impostorVAO, base);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+        instances.fence();
+        return;
+    }
+
+    // Projected radius in pixels is radius * focal / depth
+    const float focal = projection[1][1] * 0.5f * viewportHeight;
+    std::vector<size_t> bucketStart(levels.size() + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        const glm::mat4 &model = staged[i].model;
+        float radius = glm::length(glm::vec3(model[0]));
+        float depth = std::max(-(view * model[3]).z, 1e-4f);
+        uint8_t &level = bodyLevel[stagedBodies[i]];
+        level = chooseLevel(radius * focal / depth, level);
+        ++bucketStart[level + 1];
+    }
+    for (size_t l = 1; l < bucketStart.size(); ++l) bucketStart[l] += bucketStart[l - 1];
+
+    // Write the instances bucket by bucket in one pass
+    std::vector<size_t> next(bucketStart.begin(), bucketStart.end() - 1);
+    for (size_t i = 0; i < count; ++i) out[next[bodyLevel[stagedBodies[i]]]++] = staged[i];
+    const size_t base = instances.end();
+
+    for (size_t l = 0; l < levels.size(); ++l) {
+        size_t n = bucketStart[l + 1] - bucketStart[l];
+        if (n == 0) continue;
+        pointInstances(levels[l].VAO, base + bucketStart[l] * sizeof(BodyInstance));
+        glDrawArraysInstanced(GL_POINTS, 0, levels[l].vertexCount, static_cast<GLsizei>(n));
+    }
+    instances.fence();
+}
+
+// Aims the instance attributes of `vao` at instance data starting at `base`.
+void BodyRenderer::pointInstances(GLuint vao, size_t base) {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instances.id());
+    const GLsizei stride = sizeof(BodyInstance);
+    for (GLuint c = 0; c < 4; ++c) {
+        glVertexAttribPointer(1 + c, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(base + offsetof(BodyInstance, model) + c * sizeof(glm::vec4)));
+    }
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(BodyInstance, color)));
+    glVertexAttribPointer(6, 1, GL_FLOAT, GL_FALSE, stride, (void*)(base + offsetof(BodyInstance, isSun)));
+}
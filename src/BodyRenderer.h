@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "SphereMesh.h"
+#include "StreamBuffer.h"
+
+// Per-body data for one instanced draw, laid out as the vertex attributes
+// in pvShader.glsl.
+struct BodyInstance {
+    glm::mat4 model;
+    glm::vec3 color;
+    float pointSize;
+    float isSun;
+    float padding[3];
+};
+
+// Draws the bodies with one glDrawArraysInstanced per level of detail,
+// either as shared sphere point clouds or, with impostors, as one
+// camera-facing quad per body that the fragment shader ray-casts into a
+// sphere (a single draw, since a quad has no detail to drop).
+//
+//     BodyInstance *out = renderer.beginFrame(visible, bodyCount);
+//     ... fill out[i] for body visible[i] ...
+//     renderer.draw(view, projection, viewportHeight);
+class BodyRenderer {
+public:
+    // The finest mesh has `segments` x `rings`; coarser levels halve both
+    // down to MIN_SEGMENTS, and the last level is a single point.
+    BodyRenderer(int segments, int rings);
+
+    // `bodies` names which of the `bodyCount` bodies each instance is, so
+    // level hysteresis follows a body as others leave and enter the view.
+    BodyInstance *beginFrame(const std::vector<uint32_t> &bodies, size_t bodyCount);
+    void draw(const glm::mat4 &view, const glm::mat4 &projection, float viewportHeight);
+
+    // Quads for impostorvert/impostorfrag.glsl instead of mesh points for
+    // pvShader/pfShader.glsl.
+    void setImpostors(bool enabled) { impostors = enabled; }
+
+    static constexpr int MIN_SEGMENTS = 8;
+
+private:
+    struct Level {
+        GLuint VAO;
+        GLsizei vertexCount;
+        float maxRadius; // largest projected radius in pixels it is meant for
+    };
+
+    GLuint makeVAO(GLuint meshVBO);
+    uint8_t chooseLevel(float pixels, uint8_t current) const;
+    void pointInstances(GLuint vao, size_t base);
+
+    std::vector<Level> levels; // finest first, point last
+    GLuint pointVBO;
+    GLuint impostorVAO;
+    bool impostors = false;
+
+    std::vector<BodyInstance> staged;
+    std::vector<uint32_t> stagedBodies;
+    std::vector<uint8_t> bodyLevel; // hysteresis state, by body
+    StreamBuffer instances;
+    size_t capacity = 0;
+};
@@ -13,6 +13,16 @@ glm::mat4 Camera::getViewMatrix() {
     return glm::lookAt(position, position + front, up);
 }
 
+glm::mat4 Camera::getRotationMatrix() {
+    return glm::lookAt(glm::vec3(0.0f), front, up);
+}
+
+void Camera::rebase(float maxOffset) {
+    if (glm::length(position) <= maxOffset) return;
+    origin += glm::dvec3(position);
+    position = glm::vec3(0.0f);
+}
+
 void Camera::processKeyboard(Camera_Movement direction, float deltaTime) {
     float velocity = speed * deltaTime;
 
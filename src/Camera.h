@@ -14,6 +14,10 @@ enum Camera_Movement{
 class Camera{
 
 public:
+    // The camera sits at origin + position. Movement goes into the float
+    // `position`, which rebase() keeps small, so steps stay exact however
+    // far the camera has travelled.
+    glm::dvec3 origin{0.0};
     glm::vec3 position, worldUp;
     glm::vec3 right, up, front;
     float yaw, pitch;
@@ -22,6 +26,12 @@ public:
     float zoom;
     Camera(glm::vec3 position, glm::vec3 worldUp, float yaw, float pitch);
     glm::mat4 getViewMatrix();
+    // View matrix without the translation, for drawing positions that are
+    // already relative to the camera.
+    glm::mat4 getRotationMatrix();
+    glm::dvec3 worldPosition() const { return origin + glm::dvec3(position); }
+    // Folds `position` into `origin` once it is further than `maxOffset`.
+    void rebase(float maxOffset);
     void processKeyboard(Camera_Movement direction, float deltaTime);
 
     void processMouseMovement(double xoffset, double yoffset);
@@ -0,0 +1,20 @@
+#include "CameraBuffer.h"
+
+CameraBuffer::CameraBuffer() {
+    glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, UBO);
+}
+
+CameraBuffer::~CameraBuffer() {
+    glDeleteBuffers(1, &UBO);
+}
+
+void CameraBuffer::update(const glm::mat4 &view, const glm::mat4 &projection) {
+    const glm::vec4 depthMapping = depthZeroToOne ? glm::vec4(1.0f, 0.0f, 0.0f, 0.0f)
+                                                  : glm::vec4(0.5f, 0.5f, 0.0f, 0.0f);
+    CameraBlock block{view, projection, projection * view, depthMapping};
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+}
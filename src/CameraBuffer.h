@@ -0,0 +1,40 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Matrices every scene shader needs, in the std140 layout of
+//
+//     layout(std140) uniform Camera {
+//         mat4 view;
+//         mat4 projection;
+//         mat4 viewProjection;
+//         vec4 depthMapping;
+//     };
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 depthMapping; // window depth = ndc z * x + y
+};
+
+// One uniform buffer for the Camera block, written once per frame and
+// shared by every program bound to BINDING with Shader::bindBlock. Like the
+// other GL owners it lives in runSimulation, so the buffer is deleted
+// before glfwTerminate() takes the context away.
+class CameraBuffer {
+public:
+    static constexpr GLuint BINDING = 0;
+
+    CameraBuffer();
+    ~CameraBuffer();
+
+    void update(const glm::mat4 &view, const glm::mat4 &projection);
+
+    // With glClipControl(GL_ZERO_TO_ONE) NDC depth is already window depth;
+    // otherwise it is mapped from [-1, 1].
+    void setDepthZeroToOne(bool zeroToOne) { depthZeroToOne = zeroToOne; }
+
+private:
+    GLuint UBO = 0;
+    bool depthZeroToOne = false;
+};
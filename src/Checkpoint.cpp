@@ -0,0 +1,198 @@
+#include "Checkpoint.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET = 1469598103934665603ull;
+constexpr uint64_t FNV_PRIME  = 1099511628211ull;
+
+uint64_t fnv1a(uint64_t hash, const void *data, size_t bytes) {
+    const auto *p = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < bytes; ++i) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Float columns in file order.
+std::vector<std::vector<float> *> floatColumns(CheckpointState &state) {
+    return {&state.bodies.px, &state.bodies.py, &state.bodies.pz,
+            &state.bodies.vx, &state.bodies.vy, &state.bodies.vz, &state.bodies.mass,
+            &state.attributes.radius,
+            &state.attributes.colorR, &state.attributes.colorG, &state.attributes.colorB,
+            &state.orbitAngle, &state.distance, &state.orbitSpeed, &state.rotationSpeed};
+}
+
+bool writeFully(int fd, const void *data, size_t bytes) {
+    const auto *p = static_cast<const char *>(data);
+    while (bytes > 0) {
+        ssize_t n = ::write(fd, p, bytes);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        bytes -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool readFully(int fd, void *data, size_t bytes) {
+    auto *p = static_cast<char *>(data);
+    while (bytes > 0) {
+        ssize_t n = ::read(fd, p, bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        bytes -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string parentDirectory(const std::string &path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) return ".";
+    if (slash == 0) return "/";
+    return path.substr(0, slash);
+}
+
+} // namespace
+
+void CheckpointState::resize(size_t n) {
+    bodies.resize(n);
+    attributes.radius.resize(n);
+    attributes.colorR.resize(n);
+    attributes.colorG.resize(n);
+    attributes.colorB.resize(n);
+    attributes.bodyType.resize(n);
+    orbitAngle.resize(n);
+    distance.resize(n);
+    orbitSpeed.resize(n);
+    rotationSpeed.resize(n);
+}
+
+bool saveCheckpoint(const std::string &path, const CheckpointState &state) {
+    const size_t n = state.size();
+    auto columns = floatColumns(const_cast<CheckpointState &>(state));
+
+    CheckpointHeader header{};
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.bodyCount = static_cast<uint32_t>(n);
+    header.step = state.step;
+    header.simTime = state.simTime;
+    header.accumulator = state.accumulator;
+    header.fixedDt = state.fixedDt;
+
+    uint64_t hash = FNV_OFFSET;
+    for (const auto *column : columns) hash = fnv1a(hash, column->data(), n * sizeof(float));
+    hash = fnv1a(hash, state.attributes.bodyType.data(), n * sizeof(uint32_t));
+    header.checksum = hash;
+
+    std::string tmpPath = path + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Could not create checkpoint " << tmpPath << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    bool ok = writeFully(fd, &header, sizeof(header));
+    for (const auto *column : columns) ok = ok && writeFully(fd, column->data(), n * sizeof(float));
+    ok = ok && writeFully(fd, state.attributes.bodyType.data(), n * sizeof(uint32_t));
+    ok = ok && fsync(fd) == 0;
+    ok = (::close(fd) == 0) && ok;
+
+    if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Could not write checkpoint " << path << ": " << std::strerror(errno) << "\n";
+        ::unlink(tmpPath.c_str());
+        return false;
+    }
+
+    // Persist the rename itself.
+    int dir = ::open(parentDirectory(path).c_str(), O_RDONLY);
+    if (dir >= 0) {
+        fsync(dir);
+        ::close(dir);
+    }
+    return true;
+}
+
+bool loadCheckpoint(const std::string &path, CheckpointState &state) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Could not open checkpoint " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    CheckpointHeader header{};
+    bool ok = readFully(fd, &header, sizeof(header))
+              && std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0
+              && header.version == CHECKPOINT_VERSION;
+
+    // Filled aside so a bad file leaves `state` alone
+    CheckpointState loaded;
+    if (ok) {
+        // The body count is only trusted once the file is exactly that big
+        const uint64_t n = header.bodyCount;
+        const uint64_t bytesPerBody = floatColumns(loaded).size() * sizeof(float) + sizeof(uint32_t);
+        struct stat st{};
+        ok = fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) == sizeof(header) + n * bytesPerBody;
+    }
+    if (ok) {
+        const size_t n = header.bodyCount;
+        loaded.resize(n);
+        uint64_t hash = FNV_OFFSET;
+        for (auto *column : floatColumns(loaded)) {
+            ok = ok && readFully(fd, column->data(), n * sizeof(float));
+            if (ok) hash = fnv1a(hash, column->data(), n * sizeof(float));
+        }
+        ok = ok && readFully(fd, loaded.attributes.bodyType.data(), n * sizeof(uint32_t));
+        if (ok) hash = fnv1a(hash, loaded.attributes.bodyType.data(), n * sizeof(uint32_t));
+        ok = ok && hash == header.checksum;
+    }
+    ::close(fd);
+
+    if (!ok) {
+        std::cerr << "Checkpoint " << path << " is corrupt or from another version\n";
+        return false;
+    }
+
+    loaded.step = header.step;
+    loaded.simTime = header.simTime;
+    loaded.accumulator = header.accumulator;
+    loaded.fixedDt = header.fixedDt;
+    state = std::move(loaded);
+    return true;
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    wait();
+}
+
+bool CheckpointWriter::saveAsync(const std::string &path, CheckpointState &&state) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (busy) return false;
+        busy = true;
+    }
+    if (worker.joinable()) worker.join();
+
+    pending = std::move(state);
+    worker = std::thread([this, path] {
+        saveCheckpoint(path, pending);
+        std::lock_guard<std::mutex> lock(mutex);
+        busy = false;
+    });
+    return true;
+}
+
+void CheckpointWriter::wait() {
+    if (worker.joinable()) worker.join();
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Snapshot.h"
+
+// Full simulation state needed to resume a run bit for bit.
+struct CheckpointState {
+    uint64_t step = 0;
+    double simTime = 0.0;
+    double accumulator = 0.0;    // unconsumed frame time of the fixed-step loop
+    float fixedDt = 0.0f;        // 0 = variable step
+
+    BodyColumns bodies;          // positions, velocities, masses
+    BodyAttributes attributes;   // radius, color, type
+    std::vector<float> orbitAngle, distance, orbitSpeed, rotationSpeed;
+
+    void resize(size_t n);
+    size_t size() const { return bodies.size(); }
+};
+
+// Checkpoint file layout (native endianness):
+//
+//   CheckpointHeader
+//   px py pz vx vy vz mass radius colorR colorG colorB
+//   orbitAngle distance orbitSpeed rotationSpeed   (float[N] each)
+//   bodyType                                       (uint32[N])
+//
+// `checksum` is FNV-1a over everything after the header.
+
+constexpr char     CHECKPOINT_MAGIC[8] = {'N', 'B', 'C', 'K', 'P', 'T', 0, 0};
+constexpr uint32_t CHECKPOINT_VERSION  = 1;
+
+struct CheckpointHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t bodyCount;
+    uint64_t step;
+    double   simTime;
+    double   accumulator;
+    float    fixedDt;
+    uint32_t reserved;
+    uint64_t checksum;
+};
+
+static_assert(sizeof(CheckpointHeader) == 56, "checkpoint header must stay packed");
+
+// Writes `path` atomically: the data goes to a temporary file that is
+// fsynced and renamed over the old checkpoint, so a crash at any point
+// leaves either the previous or the new checkpoint intact.
+bool saveCheckpoint(const std::string &path, const CheckpointState &state);
+
+bool loadCheckpoint(const std::string &path, CheckpointState &state);
+
+// Saves checkpoints on a background thread. The caller hands over a copy
+// of the state; a save requested while the previous one is still running
+// is skipped rather than queued.
+class CheckpointWriter {
+public:
+    ~CheckpointWriter();
+
+    // Returns false if the previous save has not finished yet.
+    bool saveAsync(const std::string &path, CheckpointState &&state);
+
+    // Blocks until the pending save (if any) is on disk.
+    void wait();
+
+private:
+    std::thread worker;
+    std::mutex mutex;
+    bool busy = false;
+    CheckpointState pending;
+};
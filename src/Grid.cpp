@@ -1,126 +1,384 @@
 #include "Grid.h"
+#include <algorithm>
 #include <cmath>
+#include <cstdlib>
+#include "Simd.h"
+#include "ThreadPool.h"
+
+namespace {
+constexpr int ROWS_PER_TILE = 8;
+// Below this many vertex-source pairs, waking the pool costs more than it saves.
+constexpr size_t PARALLEL_MIN_WORK = 1 << 16;
+
+// Change tracking: source moves below SOURCE_EPSILON are ignored, and a
+// tile is recomputed once its heights may have drifted by TILE_ERROR.
+constexpr int TILE_SIZE = 8;
+constexpr float SOURCE_EPSILON = 1e-4f;
+constexpr float TILE_ERROR = 1e-3f;
+
+int wrap(long value, int n) {
+    long r = value % n;
+    return static_cast<int>(r < 0 ? r + n : r);
+}
+}
 
 Grid::Grid(int gridcount, float gridspacing)
         : gridcount(gridcount),
           gridspacing(gridspacing),
           origin(0.0f, 0.0f, 0.0f)
 {
-    generateGrid();
+    vertexCount = gridcount * gridcount;
+    heights.assign(vertexCount, 0.0f);
+    rowDirty.assign(gridcount, 1);
+    columnDirty.assign(gridcount, 0);
+    tilesPerSide = (gridcount + TILE_SIZE - 1) / TILE_SIZE;
+    tileDirty.assign(tilesPerSide * tilesPerSide, 0);
+    tileDrift.assign(tilesPerSide * tilesPerSide, 0.0f);
 
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &slotVBO);
+    heightStream.create(GL_ARRAY_BUFFER, heights.size() * sizeof(float));
 
     glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER,
-                 vertices.size() * sizeof(float),
-                 vertices.data(),
-                 GL_DYNAMIC_DRAW);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    // Slot coordinates never change; the shader turns them into x,z.
+    glBindBuffer(GL_ARRAY_BUFFER, slotVBO);
+    generateGrid();
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
+    // Only the heights are streamed; update() points attribute 1 at the
+    // region it last wrote.
+    glEnableVertexAttribArray(1);
+
+    // Topology never changes, so the line index buffer is built once and
+    // stays bound to the VAO.
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    generateIndices();
+
     glBindVertexArray(0);
-    vertexCount = static_cast<int>(vertices.size() / 3);
 }
 
+// Every segment of the torus, including the ones that wrap around. They are
+// grouped by the slot column (row) they start in, so the seam between the
+// last and first logical column (row) is one contiguous block that draw()
+// leaves out.
+void Grid::generateIndices() {
+    const int N = gridcount;
+    std::vector<GLuint> indices;
+    indices.reserve(4 * static_cast<size_t>(N) * N);
+
+    for (int x = 0; x < N; x++) {
+        for (int z = 0; z < N; z++) {
+            indices.push_back(z * N + x);
+            indices.push_back(z * N + (x + 1) % N);
+        }
+    }
+    for (int z = 0; z < N; z++) {
+        for (int x = 0; x < N; x++) {
+            indices.push_back(z * N + x);
+            indices.push_back((z + 1) % N * N + x);
+        }
+    }
+
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 indices.size() * sizeof(GLuint),
+                 indices.data(),
+                 GL_STATIC_DRAW);
+    indexCount = static_cast<int>(indices.size());
+}
+
+// Slot (column, row) of every vertex, uploaded once.
 void Grid::generateGrid(){
-    vertices.clear();
-    vertices.reserve(gridcount * gridcount * 3);
+    std::vector<float> slots;
+    slots.reserve(static_cast<size_t>(vertexCount) * 2);
 
     for (int z = 0; z < gridcount; z++) {
         for (int x = 0; x < gridcount; x++) {
+            slots.push_back(static_cast<float>(x));
+            slots.push_back(static_cast<float>(z));
+        }
+    }
+
+    glBufferData(GL_ARRAY_BUFFER,
+                 slots.size() * sizeof(float),
+                 slots.data(),
+                 GL_STATIC_DRAW);
+}
 
-            float cx = x - (gridcount / 2.0f);
-            float cz = z - (gridcount / 2.0f);
+void Grid::setOrigin(const glm::vec3 &newOrigin) {
+    // Only follow x,z so the grid is still a plane at y = 0, and only in
+    // whole cells so vertices that stay in view keep their heights.
+    long cellX = std::lround(newOrigin.x / gridspacing);
+    long cellZ = std::lround(newOrigin.z / gridspacing);
+    long dx = cellX - originCellX;
+    long dz = cellZ - originCellZ;
+    if (dx == 0 && dz == 0) return;
 
-            float worldX = origin.x + cx * gridspacing;
-            float worldZ = origin.z + cz * gridspacing;
-            float worldY = 0.0f;
+    originCellX = cellX;
+    originCellZ = cellZ;
+    origin = glm::vec3(cellX * gridspacing, 0.0f, cellZ * gridspacing);
 
-            vertices.push_back(worldX);
-            vertices.push_back(worldY);
-            vertices.push_back(worldZ);
-        }
+    if (std::labs(dx) >= gridcount || std::labs(dz) >= gridcount) {
+        std::fill(rowDirty.begin(), rowDirty.end(), 1);
+        return;
     }
+    scroll(columnOffset, dx, columnDirty);
+    scroll(rowOffset, dz, rowDirty);
 }
 
-void Grid::setOrigin(const glm::vec3 &newOrigin) {
-    // Only follow x,z so the grid is still a plane at y = 0
-    origin = glm::vec3(newOrigin.x, 0.0f, newOrigin.z);
-    generateGrid(); // recompute x,z positions; y will be recomputed in update()
+// Shifts one axis of the ring by `cells` and flags the slots that now hold
+// lattice lines which were not in view before.
+void Grid::scroll(int &offset, long cells, std::vector<uint8_t> &dirty) {
+    const int N = gridcount;
+    offset = wrap(offset + cells, N);
+    long first = cells > 0 ? N - cells : 0;
+    long last = cells > 0 ? N : -cells;
+    for (long l = first; l < last; ++l) dirty[wrap(l + offset, N)] = 1;
+}
+
+// Largest source move since the heights were last brought up to date;
+// infinite when sources were added or removed or changed mass.
+float Grid::sourceChange(const std::vector<Grid::GravitySource> &sources) const {
+    if (sources.size() != lastSources.size()) return INFINITY;
+    float change = 0.0f;
+    for (size_t s = 0; s < sources.size(); ++s) {
+        if (sources[s].mass != lastSources[s].mass) return INFINITY;
+        change = std::max(change, glm::length(sources[s].position - lastSources[s].position));
+    }
+    return change;
 }
 
 void Grid::update(const std::vector<Grid::GravitySource> &sources) {
+    const int N = gridcount;
+    const size_t count = sources.size();
 
-    for (int i = 0; i < vertexCount; i++) {
+    // Moves below the tolerance are left to accumulate against lastSources
+    // until they matter; a paused sim costs nothing here.
+    float change = sourceChange(sources);
+    if (change > SOURCE_EPSILON) {
+        bool resized = sources.size() != lastSources.size();
+        prepareSources(sources);
+        if (resized || useTree) {
+            std::fill(rowDirty.begin(), rowDirty.end(), 1);
+        } else {
+            accumulateDrift(sources);
+        }
+        lastSources = sources;
+    }
 
-        float &x = vertices[i*3 + 0];
-        float &y = vertices[i*3 + 1];
-        float &z = vertices[i*3 + 2];
+    size_t dirtyRows = std::count(rowDirty.begin(), rowDirty.end(), 1);
+    size_t dirtyColumns = std::count(columnDirty.begin(), columnDirty.end(), 1);
+    size_t dirtyTiles = std::count(tileDirty.begin(), tileDirty.end(), 1);
+    size_t dirtyVertices = dirtyRows * N + dirtyColumns * (N - dirtyRows) + dirtyTiles * TILE_SIZE * TILE_SIZE;
+    if (dirtyVertices == 0) return;
+
+    if (useTree || dirtyVertices * count >= PARALLEL_MIN_WORK) {
+        ThreadPool::global().parallelFor(N, ROWS_PER_TILE, [this](size_t begin, size_t end) {
+            updateRows(static_cast<int>(begin), static_cast<int>(end));
+        });
+    } else {
+        updateRows(0, N);
+    }
+    if (dirtyRows == static_cast<size_t>(N)) std::fill(tileDrift.begin(), tileDrift.end(), 0.0f);
+    std::fill(rowDirty.begin(), rowDirty.end(), 0);
+    std::fill(columnDirty.begin(), columnDirty.end(), 0);
+    std::fill(tileDirty.begin(), tileDirty.end(), 0);
 
-        float dip = 0.0f;
+    // heights stays the master copy because only dirty slots are rewritten;
+    // the whole array goes into the next free region in one pass.
+    float *mapped = static_cast<float *>(heightStream.begin());
+    std::copy(heights.begin(), heights.end(), mapped);
+    size_t offset = heightStream.end();
 
-        // Make the grid dip weaker so it stays in view
-        float G = 0.3;
-        float soft = 0.5f;
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, heightStream.id());
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*)offset);
+    glBindVertexArray(0);
+}
 
-        for (const auto &src : sources) {
+// Squared distance along one axis from p to the lattice lines held by slots
+// [first, last), which wrap around the seam when they straddle it.
+float Grid::slotRangeDistance2(int first, int last, int offset, float corner, float p) const {
+    const int N = gridcount;
+    auto outside = [&](int lo, int hi) {
+        float a = corner + lo * gridspacing, b = corner + hi * gridspacing;
+        return std::max(0.0f, std::max(a - p, p - b));
+    };
+    int lo = wrap(first - offset, N), hi = wrap(last - 1 - offset, N);
+    float d = lo <= hi ? outside(lo, hi) : std::min(outside(lo, N - 1), outside(0, hi));
+    return d * d;
+}
 
-            float dx = x - src.position.x;
-            float dz = z - src.position.z;
-            float dy = 0.0f - src.position.y;
+// Adds to each tile a bound on how far its heights can have moved since
+// lastSources and flags the tiles that went over TILE_ERROR. Per source,
+// |m'/r' - m/r| <= m' |dp| / (r r') + |dm| / r, with r, r' no smaller than
+// the softened distance from the old and new position to the tile.
+void Grid::accumulateDrift(const std::vector<Grid::GravitySource> &sources) {
+    const int N = gridcount;
+    const int T = tilesPerSide;
+    const float cornerX = origin.x - N / 2.0f * gridspacing;
+    const float cornerZ = origin.z - N / 2.0f * gridspacing;
+    const float soft2 = GRID_SOFTENING * GRID_SOFTENING;
 
-            float dist = std::sqrt(dx*dx + dy*dy + dz*dz + soft*soft);
+    auto tileDistance = [&](int tx, int tz, const glm::vec3 &p) {
+        float dx2 = slotRangeDistance2(tx * TILE_SIZE, std::min(N, (tx + 1) * TILE_SIZE), columnOffset, cornerX, p.x);
+        float dz2 = slotRangeDistance2(tz * TILE_SIZE, std::min(N, (tz + 1) * TILE_SIZE), rowOffset, cornerZ, p.z);
+        return std::sqrt(dx2 + dz2 + p.y * p.y + soft2);
+    };
 
-            dip += -G * src.mass / dist;  // U ~ -G * m / r
+    for (int t = 0; t < T * T; ++t) {
+        int tx = t % T, tz = t / T;
+        float bound = 0.0f;
+        for (size_t s = 0; s < sources.size(); ++s) {
+            const GravitySource &before = lastSources[s], &after = sources[s];
+            float rBefore = tileDistance(tx, tz, before.position);
+            float rAfter = tileDistance(tx, tz, after.position);
+            float moved = glm::length(after.position - before.position);
+            bound += after.mass * moved / (rBefore * rAfter) + std::fabs(after.mass - before.mass) / rBefore;
         }
+        tileDrift[t] += GRID_G * bound;
+        if (tileDrift[t] > TILE_ERROR) {
+            tileDirty[t] = 1;
+            tileDrift[t] = 0.0f;
+        }
+    }
+}
+
+void Grid::prepareSources(const std::vector<Grid::GravitySource> &sources) {
+    const size_t count = sources.size();
+    useTree = openingAngle > 0.0f && count >= GRID_TREE_MIN_SOURCES;
 
-        y = dip;
+    if (useTree) {
+        treePositions.resize(count);
+        treeMasses.resize(count);
+        for (size_t s = 0; s < count; ++s) {
+            treePositions[s] = sources[s].position;
+            treeMasses[s] = sources[s].mass;
+        }
+        tree.build(treePositions, treeMasses);
+        return;
     }
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferSubData(GL_ARRAY_BUFFER,
-                    0,
-                    vertices.size() * sizeof(float),
-                    vertices.data());
+    srcX.resize(count);
+    srcZ.resize(count);
+    srcH.resize(count);
+    srcW.resize(count);
+    for (size_t s = 0; s < count; ++s) {
+        const auto &src = sources[s];
+        srcX[s] = src.position.x;
+        srcZ[s] = src.position.z;
+        srcH[s] = src.position.y * src.position.y + GRID_SOFTENING * GRID_SOFTENING;
+        srcW[s] = -GRID_G * src.mass; // U ~ -G * m / r
+    }
 }
 
-void Grid::draw(Shader &shader)
-{
-    glBindVertexArray(VAO);
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+// Recomputes the dirty vertices in slot rows [rowBegin, rowEnd). Slots in a
+// row run through the lattice in order except at the seam, so each run of
+// dirty slots is cut there and evaluated as one or two straight spans.
+void Grid::updateRows(int rowBegin, int rowEnd) {
+    const int N = gridcount;
+    const float cornerX = origin.x - N / 2.0f * gridspacing;
+    const float cornerZ = origin.z - N / 2.0f * gridspacing;
 
-    int N = gridcount;
+    for (int z = rowBegin; z < rowEnd; z++) {
+        float *row = &heights[static_cast<size_t>(z) * N];
+        float worldZ = cornerZ + wrap(z - rowOffset, N) * gridspacing;
+        const bool wholeRow = rowDirty[z] != 0;
+        const uint8_t *tiles = &tileDirty[static_cast<size_t>(z / TILE_SIZE) * tilesPerSide];
+        auto dirty = [&](int x) { return wholeRow || columnDirty[x] || tiles[x / TILE_SIZE]; };
 
-    // rows
-    for (int z = 0; z < N; z++) {
-        int start = z * N;
-        glDrawArrays(GL_LINE_STRIP, start, N);
+        int x = 0;
+        while (x < N) {
+            if (!dirty(x)) {
+                x++;
+                continue;
+            }
+            int end = x + 1;
+            while (end < N && end != columnOffset && dirty(end)) end++;
+            float worldX = cornerX + wrap(x - columnOffset, N) * gridspacing;
+            if (useTree)
+                evaluateSpanTree(row + x, end - x, worldX, worldZ);
+            else
+                evaluateSpan(row + x, end - x, worldX, worldZ);
+            x = end;
+        }
     }
+}
 
-    // columns
-    for (int x = 0; x < N; x++) {
-        std::vector<GLuint> columnIndices;
-        columnIndices.reserve(N);
+// Potential along a straight run of vertices, four at a time. x is an
+// arithmetic sequence and z is constant, so neither is loaded.
+void Grid::evaluateSpan(float *out, int n, float worldX, float worldZ) const {
+    const size_t count = srcX.size();
+    const float *sx = srcX.data(), *sz = srcZ.data(), *sh = srcH.data(), *sw = srcW.data();
+    float4 z4 = splat4(worldZ);
 
-        for (int z = 0; z < N; z++) {
-            columnIndices.push_back(z * N + x);
+    for (int i = 0; i < n; i += 4) {
+        float4 x4 = ramp4(worldX + i * gridspacing, gridspacing);
+        float4 dip = splat4(0.0f);
+
+        for (size_t s = 0; s < count; ++s) {
+            float4 dx = x4 - splat4(sx[s]);
+            float4 dz = z4 - splat4(sz[s]);
+            float4 dist2 = dx * dx + dz * dz + splat4(sh[s]);
+            dip = dip + splat4(sw[s]) * rsqrt4(dist2);
         }
 
-        GLuint tempEBO;
-        glGenBuffers(1, &tempEBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tempEBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                     columnIndices.size() * sizeof(GLuint),
-                     columnIndices.data(),
-                     GL_STATIC_DRAW);
+        if (i + 4 <= n) {
+            store4(out + i, dip);
+        } else {
+            float lanes[4];
+            store4(lanes, dip);
+            for (int k = 0; k < n - i; k++) out[i + k] = lanes[k];
+        }
+    }
+}
 
-        glDrawElements(GL_LINE_STRIP, N, GL_UNSIGNED_INT, 0);
+void Grid::evaluateSpanTree(float *out, int n, float worldX, float worldZ) const {
+    const float soft2 = GRID_SOFTENING * GRID_SOFTENING;
+    for (int i = 0; i < n; i++) {
+        glm::vec3 p(worldX + i * gridspacing, 0.0f, worldZ);
+        out[i] = -GRID_G * tree.potential(p, openingAngle, soft2);
+    }
+}
 
-        glDeleteBuffers(1, &tempEBO);
+void Grid::draw(Shader &shader, const glm::dvec3 &eye)
+{
+    const int N = gridcount;
+    if (uniformShader != &shader) {
+        originUniform = shader.uniform<glm::vec3>("gridOrigin");
+        offsetUniform = shader.uniform<glm::vec2>("gridOffset");
+        countUniform = shader.uniform<float>("gridCount");
+        spacingUniform = shader.uniform<float>("gridSpacing");
+        uniformShader = &shader;
     }
+    shader.set(originUniform, glm::vec3(glm::dvec3(origin) - eye));
+    shader.set(offsetUniform, glm::vec2(columnOffset, rowOffset));
+    shader.set(countUniform, static_cast<float>(N));
+    shader.set(spacingUniform, gridspacing);
 
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    // Each direction is one block of N segment groups; skip the group that
+    // joins the last lattice line back to the first.
+    const GLsizei group = 2 * N;
+    const int seamColumn = wrap(columnOffset - 1, N);
+    const int seamRow = wrap(rowOffset - 1, N);
+    const GLsizei rowBase = group * N;
+
+    GLsizei counts[4] = {
+        group * seamColumn,
+        group * (N - 1 - seamColumn),
+        group * seamRow,
+        group * (N - 1 - seamRow),
+    };
+    const void *offsets[4] = {
+        (void*)0,
+        (void*)(sizeof(GLuint) * group * (seamColumn + 1)),
+        (void*)(sizeof(GLuint) * rowBase),
+        (void*)(sizeof(GLuint) * (rowBase + group * (seamRow + 1))),
+    };
+
+    glBindVertexArray(VAO);
+    glMultiDrawElements(GL_LINES, counts, GL_UNSIGNED_INT, offsets, 4);
+    heightStream.fence();
 }
@@ -1,9 +1,18 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include "Shader.h"
+#include "PotentialTree.h"
+#include "StreamBuffer.h"
+
+// Make the grid dip weaker so it stays in view
+constexpr float GRID_G = 0.3f;
+constexpr float GRID_SOFTENING = 0.5f;
+// From this many sources the O(log S) tree walk beats a direct sum.
+constexpr size_t GRID_TREE_MIN_SOURCES = 256;
 
 class Grid {
 public:
@@ -14,20 +23,71 @@ public:
 
     Grid(int gridcount, float gridspacing);
 
+    // Brings the heights up to date with `sources`. Does nothing if they
+    // have not moved, and otherwise only recomputes the tiles whose bound on
+    // accumulated change has grown past a small threshold.
     void update(const std::vector<Grid::GravitySource> &sources);
-    void draw(Shader &shader);
+    // `eye` is the camera's world position; the grid is drawn relative to it.
+    void draw(Shader &shader, const glm::dvec3 &eye);
 
-    // Set where the grid is centered in world space (x,z). y is always 0.
+    // Set where the grid is centered in world space (x,z), snapped to whole
+    // cells. y is always 0. Heights live in a toroidal ring, so only the rows
+    // and columns that scroll into view are recomputed on the next update().
     void setOrigin(const glm::vec3 &newOrigin);
 
+    // Opening angle for the tree evaluation used with many sources. Larger
+    // is faster but lets the sag drift further from the exact sum; 0 forces
+    // the direct sum.
+    void setOpeningAngle(float theta) { openingAngle = theta; }
+
 private:
     void generateGrid();
+    void generateIndices();
+    void scroll(int &offset, long cells, std::vector<uint8_t> &dirty);
+    float sourceChange(const std::vector<Grid::GravitySource> &sources) const;
+    void accumulateDrift(const std::vector<Grid::GravitySource> &sources);
+    float slotRangeDistance2(int first, int last, int offset, float corner, float p) const;
+    void prepareSources(const std::vector<Grid::GravitySource> &sources);
+    void updateRows(int rowBegin, int rowEnd);
+    void evaluateSpan(float *out, int n, float worldX, float worldZ) const;
+    void evaluateSpanTree(float *out, int n, float worldX, float worldZ) const;
 
     int gridcount;
     float gridspacing;
-    GLuint VAO, VBO;
+    GLuint VAO, slotVBO, EBO;
+    StreamBuffer heightStream;
+
+    // Handles into the shader last drawn with
+    const Shader *uniformShader = nullptr;
+    Uniform<glm::vec3> originUniform;
+    Uniform<glm::vec2> offsetUniform;
+    Uniform<float> countUniform, spacingUniform;
     int vertexCount;
-    std::vector<float> vertices;
+    int indexCount;
+    std::vector<float> heights; // y per slot, row-major
 
     glm::vec3 origin; // world-space center in XZ for the grid
+    long originCellX = 0, originCellZ = 0;
+
+    // Slot (x, z) holds lattice column (x - columnOffset) mod N and row
+    // (z - rowOffset) mod N.
+    int columnOffset = 0, rowOffset = 0;
+    std::vector<uint8_t> rowDirty, columnDirty; // by slot
+
+    // Sources the heights are up to date with, within tileDrift per tile
+    // of TILE_SIZE x TILE_SIZE slots.
+    std::vector<Grid::GravitySource> lastSources;
+    int tilesPerSide;
+    std::vector<float> tileDrift;
+    std::vector<uint8_t> tileDirty;
+
+    // Sources flattened for the vector kernel: x, z, y^2 + soft^2, -G * m
+    std::vector<float> srcX, srcZ, srcH, srcW;
+
+    // Many sources go through a tree instead
+    float openingAngle = 0.5f;
+    bool useTree = false;
+    PotentialTree tree;
+    std::vector<glm::vec3> treePositions;
+    std::vector<float> treeMasses;
 };
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+
+// Spreads the low 21 bits of x so there are two zero bits between each;
+// OR-ing three of these shifted by 0, 1 and 2 gives a 63-bit Morton code.
+inline uint64_t spreadBits(uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffull;
+    x = (x | x << 16) & 0x1f0000ff0000ffull;
+    x = (x | x << 8)  & 0x100f00f00f00f00full;
+    x = (x | x << 4)  & 0x10c30c30c30c30c3ull;
+    x = (x | x << 2)  & 0x1249249249249249ull;
+    return x;
+}
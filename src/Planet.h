@@ -1,7 +1,5 @@
 #pragma once
-#include <vector>
 #include <glm/glm.hpp>
-#include "Shader.h"
 
 enum class BodyType { Star, Planetary };
 
@@ -15,7 +13,7 @@ public:
     float rotationSpeed;
     glm::vec3 color;
 
-    glm::mat4 model;
+    glm::mat4 model; // relative to the eye passed to update()
     glm::vec3 worldPosition;
     glm::vec3 velocity;
 
@@ -23,16 +21,12 @@ public:
            float orbitSpeed, float rotationSpeed, glm::vec3 color,
            BodyType type = BodyType::Planetary);
 
-    void update(float time);
-    void draw(Shader &shader);
+    // `eye` is the camera position in the same frame as worldPosition; the
+    // difference is taken in double so nearby bodies keep full precision
+    // however far both are from the origin.
+    void update(float time, const glm::dvec3 &eye);
     bool isStar() const { return bodyType == BodyType::Star; }
 
 private:
-    void generateSphere(int segments, int rings, const glm::vec3 &surfaceColor);
-
     BodyType bodyType;
-
-    std::vector<float> vertices;
-    int vertexCount = 0;
-    unsigned int VAO = 0, VBO = 0;
 };
@@ -0,0 +1,128 @@
+#include "PotentialTree.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "Morton.h"
+
+namespace {
+
+constexpr uint32_t LEAF_SIZE = 8;
+constexpr int MAX_LEVEL = 21;  // 21 bits per axis in a 63-bit Morton code
+
+} // namespace
+
+void PotentialTree::build(const std::vector<glm::vec3> &positions, const std::vector<float> &masses) {
+    nodes.clear();
+    const size_t n = positions.size();
+    if (n == 0) return;
+
+    glm::vec3 lo = positions[0], hi = positions[0];
+    for (const auto &p : positions) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    glm::vec3 extent = hi - lo;
+    float size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+    float scale = static_cast<float>((1u << MAX_LEVEL) - 1) / size;
+
+    // Sort sources along the Morton curve so every cell is a contiguous range.
+    std::vector<std::pair<uint64_t, uint32_t>> keyed(n);
+    for (size_t i = 0; i < n; ++i) {
+        glm::vec3 q = (positions[i] - lo) * scale;
+        uint64_t code = spreadBits(static_cast<uint64_t>(q.x))
+                        | spreadBits(static_cast<uint64_t>(q.y)) << 1
+                        | spreadBits(static_cast<uint64_t>(q.z)) << 2;
+        keyed[i] = {code, static_cast<uint32_t>(i)};
+    }
+    std::sort(keyed.begin(), keyed.end());
+
+    codes.resize(n);
+    sortedPos.resize(n);
+    sortedMass.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        codes[i] = keyed[i].first;
+        sortedPos[i] = positions[keyed[i].second];
+        sortedMass[i] = masses[keyed[i].second];
+    }
+
+    nodes.reserve(2 * n / LEAF_SIZE + 1);
+    nodes.push_back({});
+    buildNode(0, 0, static_cast<uint32_t>(n), 0, size);
+}
+
+// Fills nodes[index] for sources [begin, end) and appends its children.
+void PotentialTree::buildNode(uint32_t index, uint32_t begin, uint32_t end, int level, float size) {
+    Node node{};
+    node.size = size;
+    node.begin = begin;
+    node.end = end;
+
+    if (end - begin > LEAF_SIZE && level < MAX_LEVEL) {
+        // Split on the next octant digit; it is non-decreasing across the range.
+        int shift = 3 * (MAX_LEVEL - 1 - level);
+        uint32_t ranges[9];
+        uint32_t count = 0;
+        uint32_t start = begin;
+        while (start < end) {
+            uint64_t digit = (codes[start] >> shift) & 7;
+            uint32_t stop = start;
+            while (stop < end && ((codes[stop] >> shift) & 7) == digit) ++stop;
+            ranges[count++] = start;
+            start = stop;
+        }
+        ranges[count] = end;
+
+        node.firstChild = static_cast<uint32_t>(nodes.size());
+        node.childCount = count;
+        nodes.resize(nodes.size() + count);
+        for (uint32_t c = 0; c < count; ++c)
+            buildNode(node.firstChild + c, ranges[c], ranges[c + 1], level + 1, size * 0.5f);
+
+        glm::vec3 weighted(0.0f);
+        for (uint32_t c = 0; c < count; ++c) {
+            const Node &child = nodes[node.firstChild + c];
+            node.mass += child.mass;
+            weighted += child.com * child.mass;
+        }
+        node.com = node.mass > 0.0f ? weighted / node.mass : nodes[node.firstChild].com;
+    } else {
+        glm::vec3 weighted(0.0f), sum(0.0f);
+        for (uint32_t i = begin; i < end; ++i) {
+            node.mass += sortedMass[i];
+            weighted += sortedPos[i] * sortedMass[i];
+            sum += sortedPos[i];
+        }
+        node.com = node.mass > 0.0f ? weighted / node.mass : sum / static_cast<float>(end - begin);
+    }
+
+    nodes[index] = node;
+}
+
+float PotentialTree::potential(const glm::vec3 &p, float theta, float softening2) const {
+    if (nodes.empty()) return 0.0f;
+
+    const float theta2 = theta * theta;
+    float phi = 0.0f;
+
+    uint32_t stack[8 * MAX_LEVEL + 1];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node &node = nodes[stack[--top]];
+        glm::vec3 d = node.com - p;
+        float dist2 = glm::dot(d, d);
+
+        if (node.childCount == 0) {
+            for (uint32_t i = node.begin; i < node.end; ++i) {
+                glm::vec3 ds = sortedPos[i] - p;
+                phi += sortedMass[i] / std::sqrt(glm::dot(ds, ds) + softening2);
+            }
+        } else if (node.size * node.size < theta2 * dist2) {
+            phi += node.mass / std::sqrt(dist2 + softening2);
+        } else {
+            for (uint32_t c = 0; c < node.childCount; ++c) stack[top++] = node.firstChild + c;
+        }
+    }
+    return phi;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Octree over point masses for approximate softened potentials,
+// sum m / sqrt(r^2 + soft^2), in O(log n) per query. Cells that look
+// small from the query point (size < theta * distance) are replaced by a
+// point mass at their center of mass; theta = 0 reproduces the direct sum.
+class PotentialTree {
+public:
+    void build(const std::vector<glm::vec3> &positions, const std::vector<float> &masses);
+
+    float potential(const glm::vec3 &p, float theta, float softening2) const;
+
+    bool empty() const { return nodes.empty(); }
+
+private:
+    struct Node {
+        glm::vec3 com;       // center of mass
+        float mass;
+        float size;          // edge length of the cell
+        uint32_t firstChild; // children are contiguous
+        uint32_t childCount; // 0 for leaves
+        uint32_t begin, end; // sources in sorted order
+    };
+
+    void buildNode(uint32_t index, uint32_t begin, uint32_t end, int level, float size);
+
+    std::vector<Node> nodes;
+    std::vector<uint64_t> codes;     // Morton codes, sorted
+    std::vector<glm::vec3> sortedPos;
+    std::vector<float> sortedMass;
+};
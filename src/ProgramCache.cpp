@@ -0,0 +1,139 @@
+#include "ProgramCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET = 1469598103934665603ull;
+constexpr uint64_t FNV_PRIME  = 1099511628211ull;
+
+uint64_t fnv1a(uint64_t hash, const void *data, size_t bytes) {
+    const auto *p = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < bytes; ++i) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Hashes the length as well, so ("ab", "c") and ("a", "bc") differ.
+uint64_t hashString(uint64_t hash, const std::string &s) {
+    uint64_t length = s.size();
+    hash = fnv1a(hash, &length, sizeof(length));
+    return fnv1a(hash, s.data(), s.size());
+}
+
+uint64_t hashGlString(uint64_t hash, GLenum name) {
+    const GLubyte *s = glGetString(name);
+    return hashString(hash, s ? reinterpret_cast<const char *>(s) : "");
+}
+
+std::string &cacheDirectory() {
+    static std::string directory = "shader_cache";
+    return directory;
+}
+
+std::string entryPath(uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llx.bin", static_cast<unsigned long long>(key));
+    return cacheDirectory() + name;
+}
+
+} // namespace
+
+void setProgramCacheDirectory(const std::string &directory) {
+    cacheDirectory() = directory;
+}
+
+bool programBinariesSupported() {
+    if (!glGetProgramBinary || !glProgramBinary || !glProgramParameteri) return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+uint64_t programCacheKey(const std::string &vertexCode, const std::string &fragmentCode) {
+    uint64_t hash = FNV_OFFSET;
+    hash = hashString(hash, vertexCode);
+    hash = hashString(hash, fragmentCode);
+    hash = hashGlString(hash, GL_VENDOR);
+    hash = hashGlString(hash, GL_RENDERER);
+    hash = hashGlString(hash, GL_VERSION);
+    return hash;
+}
+
+bool loadProgramBinary(GLuint program, uint64_t key) {
+    if (cacheDirectory().empty() || !programBinariesSupported()) return false;
+
+    std::ifstream in(entryPath(key), std::ios::binary);
+    if (!in) return false;
+
+    ProgramCacheHeader header{};
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))) return false;
+    if (std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != PROGRAM_CACHE_VERSION || header.key != key) {
+        return false;
+    }
+
+    // The length is only trusted once the file is known to hold it
+    const std::streamoff bodyStart = in.tellg();
+    in.seekg(0, std::ios::end);
+    const std::streamoff remaining = in.tellg() - bodyStart;
+    if (bodyStart < 0 || remaining < 0 || header.length != static_cast<uint64_t>(remaining) ||
+        header.length > static_cast<uint64_t>(std::numeric_limits<GLsizei>::max())) {
+        return false;
+    }
+    in.seekg(bodyStart);
+
+    std::vector<char> binary(header.length);
+    if (!in.read(binary.data(), static_cast<std::streamsize>(binary.size()))) return false;
+    if (fnv1a(FNV_OFFSET, binary.data(), binary.size()) != header.checksum) return false;
+
+    // A driver update that kept the same strings can still reject it
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+void saveProgramBinary(GLuint program, uint64_t key) {
+    if (cacheDirectory().empty() || !programBinariesSupported()) return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(static_cast<size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0) return;
+    binary.resize(static_cast<size_t>(written));
+
+    ProgramCacheHeader header{};
+    std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_CACHE_VERSION;
+    header.format = format;
+    header.key = key;
+    header.length = binary.size();
+    header.checksum = fnv1a(FNV_OFFSET, binary.data(), binary.size());
+
+    // Written aside and renamed, so a concurrent launch never reads half a file
+    mkdir(cacheDirectory().c_str(), 0755);
+    const std::string path = entryPath(key);
+    const std::string tmpPath = path + "." + std::to_string(getpid()) + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+    out.close();
+    if (!out || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Could not write program cache entry " << path << "\n";
+        std::remove(tmpPath.c_str());
+    }
+}
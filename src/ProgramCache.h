@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <glad/glad.h>
+
+// On-disk cache of linked program binaries (glGetProgramBinary), so a
+// launch can skip GLSL compilation. Entries are keyed by the shader sources
+// and the driver's vendor, renderer and version strings; anything that does
+// not load cleanly is treated as a miss and the caller compiles as usual.
+//
+// Cache file layout (native endianness):
+//
+//   ProgramCacheHeader
+//   binary                   (length bytes, in `format`)
+//
+// `checksum` is FNV-1a over the binary.
+
+constexpr char     PROGRAM_CACHE_MAGIC[8] = {'N', 'B', 'P', 'R', 'O', 'G', 0, 0};
+constexpr uint32_t PROGRAM_CACHE_VERSION  = 1;
+
+struct ProgramCacheHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t key;
+    uint64_t length;
+    uint64_t checksum;
+};
+
+static_assert(sizeof(ProgramCacheHeader) == 40, "program cache header must stay packed");
+
+// Where entries are kept; empty turns the cache off. Defaults to
+// "shader_cache" in the working directory.
+void setProgramCacheDirectory(const std::string &directory);
+
+// Needs a current context for the driver strings.
+uint64_t programCacheKey(const std::string &vertexCode, const std::string &fragmentCode);
+
+// Loads the cached binary for `key` into `program`. True only if the
+// driver accepted it and the program is linked.
+bool loadProgramBinary(GLuint program, uint64_t key);
+
+// Stores the binary of a linked `program`, which should have been linked
+// with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+void saveProgramBinary(GLuint program, uint64_t key);
+
+// Whether the driver can hand out program binaries at all.
+bool programBinariesSupported();
@@ -0,0 +1,84 @@
+#include "ReplayPlayer.h"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+bool ReplayPlayer::open(const std::string &path) {
+    if (!reader.open(path)) return false;
+    if (reader.chunkCount() == 0) {
+        std::cerr << "Snapshot file " << path << " holds no steps\n";
+        reader.close();
+        return false;
+    }
+    reader.attributes(attrs);
+    loaded = SIZE_MAX;
+    seek(startTime());
+    return true;
+}
+
+void ReplayPlayer::seek(double time) {
+    playTime = std::min(std::max(time, startTime()), endTime());
+    if (load(reader.chunkForTime(playTime))) interpolate();
+}
+
+bool ReplayPlayer::load(size_t i) {
+    if (i == loaded) return true;
+
+    size_t next = std::min(i + 1, reader.chunkCount() - 1);
+    bool ok;
+    if (loaded != SIZE_MAX && i == loaded + 1) {
+        // Playing forward: the old upper snapshot becomes the lower one.
+        std::swap(a, b);
+        ok = next == i || reader.read(next, b);
+    } else {
+        ok = reader.read(i, a);
+        if (ok) {
+            if (next == i) b = a;
+            else ok = reader.read(next, b);
+        }
+    }
+    if (!ok) {
+        std::cerr << "Could not decode snapshot chunk " << i << "\n";
+        loaded = SIZE_MAX;
+        return false;
+    }
+    loaded = i;
+    return true;
+}
+
+// Cubic Hermite between the two snapshots, using the stored velocities as
+// tangents, so curved orbits stay curved between samples.
+void ReplayPlayer::interpolate() {
+    const size_t n = a.size();
+    current.resize(n);
+
+    size_t next = std::min(loaded + 1, reader.chunkCount() - 1);
+    double t0 = reader.chunk(loaded).time;
+    double h = reader.chunk(next).time - t0;
+    float s = h > 0.0 ? static_cast<float>((playTime - t0) / h) : 0.0f;
+    float hf = static_cast<float>(h);
+
+    float s2 = s * s, s3 = s2 * s;
+    float h00 = 2 * s3 - 3 * s2 + 1;
+    float h10 = (s3 - 2 * s2 + s) * hf;
+    float h01 = -2 * s3 + 3 * s2;
+    float h11 = (s3 - s2) * hf;
+
+    const std::vector<float> *pa[3] = {&a.px, &a.py, &a.pz};
+    const std::vector<float> *pb[3] = {&b.px, &b.py, &b.pz};
+    const std::vector<float> *va[3] = {&a.vx, &a.vy, &a.vz};
+    const std::vector<float> *vb[3] = {&b.vx, &b.vy, &b.vz};
+    std::vector<float> *pc[3] = {&current.px, &current.py, &current.pz};
+    std::vector<float> *vc[3] = {&current.vx, &current.vy, &current.vz};
+
+    for (int c = 0; c < 3; ++c) {
+        const float *p0 = pa[c]->data(), *p1 = pb[c]->data();
+        const float *v0 = va[c]->data(), *v1 = vb[c]->data();
+        float *p = pc[c]->data(), *v = vc[c]->data();
+        for (size_t i = 0; i < n; ++i) {
+            p[i] = h00 * p0[i] + h10 * v0[i] + h01 * p1[i] + h11 * v1[i];
+            v[i] = v0[i] + (v1[i] - v0[i]) * s;
+        }
+    }
+    current.mass = s < 0.5f ? a.mass : b.mass;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include "Snapshot.h"
+#include "SnapshotReader.h"
+
+// Plays back a recorded trajectory. Keeps the two snapshots around the
+// playback time decoded and interpolates between them, so scrubbing costs
+// one chunk decode per snapshot crossed and nothing in between.
+class ReplayPlayer {
+public:
+    bool open(const std::string &path);
+    bool isOpen() const { return reader.isOpen(); }
+
+    const BodyAttributes &attributes() const { return attrs; }
+
+    double startTime() const { return reader.chunk(0).time; }
+    double endTime() const { return reader.chunk(reader.chunkCount() - 1).time; }
+    double time() const { return playTime; }
+
+    // Moves the playhead (clamped to the recording) and refreshes frame().
+    void seek(double time);
+    void advance(double dt) { seek(playTime + dt); }
+
+    // Body state at the playhead.
+    const BodyColumns &frame() const { return current; }
+
+private:
+    bool load(size_t i);
+    void interpolate();
+
+    SnapshotReader reader;
+    BodyAttributes attrs;
+
+    BodyColumns a, b;        // snapshots at chunk loaded and loaded + 1
+    BodyColumns current;
+    size_t loaded = SIZE_MAX;
+    double playTime = 0.0;
+};
@@ -1,47 +1,158 @@
 #pragma once
+#include <algorithm>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include <fstream>
-#include <sstream>
 #include <iostream>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "ProgramCache.h"
+#include "ShaderSource.h"
 
 using namespace std;
 
+// A uniform resolved once by name. It indexes a slot in its Shader rather
+// than holding a location, so it stays valid if the program is relinked.
+template <typename T>
+struct Uniform {
+    int slot = -1;
+};
+
 class Shader{
 
 public:
     unsigned int ID;
 
-    Shader(const char* vertexPath, const char* fragmentPath){
-        //Read vertex and fragment glsl files
+    // Names of files known to ShaderSource, e.g. "gridvert.glsl".
+    Shader(const char* vertexName, const char* fragmentName)
+        : vertexFile(vertexName), fragmentFile(fragmentName){
         string vertexCode, fragmentCode;
-        ifstream fShaderFile, vShaderFile;
-        vShaderFile.exceptions ( std::ifstream::badbit);
-        fShaderFile.exceptions ( std::ifstream::badbit);
-        string vline;
-        string fline;
+        vector<string> fragmentFiles;
+        loadShaderSource(vertexFile, vertexCode, &files);
+        loadShaderSource(fragmentFile, fragmentCode, &fragmentFiles);
+        for (const string &f : fragmentFiles) {
+            if (std::find(files.begin(), files.end(), f) == files.end()) files.push_back(f);
+        }
 
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
+        buildProgram(vertexCode, fragmentCode, ID);
+        cacheUniforms();
+        bindBlocks();
+    }
 
-        if(!vShaderFile.is_open()){
-            cerr << "Could not read the file";
-        }
-        while(getline(vShaderFile, vline)){
-            vertexCode += vline + "\n";
+    void use()const{
+        glUseProgram(ID);
+    }
+
+    // Swaps in a program built from new sources. If they do not compile
+    // the current program stays and this returns false. Uniform handles
+    // and block bindings carry over. Edits come and go, so relinked
+    // programs bypass the binary cache rather than leave an entry per save.
+    bool relink(const string &vertexCode, const string &fragmentCode){
+        unsigned int program;
+        if (!buildProgram(vertexCode, fragmentCode, program, false)) {
+            glDeleteProgram(program);
+            return false;
         }
-        if(!fShaderFile.is_open()){
-            cerr << "Could not read the file";
+        glDeleteProgram(ID);
+        ID = program;
+        cacheUniforms();
+        bindBlocks();
+        return true;
+    }
+
+    const string &vertexName() const{ return vertexFile; }
+    const string &fragmentName() const{ return fragmentFile; }
+    // Both sources and everything they include
+    const vector<string> &sourceFiles() const{ return files; }
+
+    // Location of an active uniform, or -1 (which glUniform* ignores) if the
+    // program has none by that name.
+    GLint location(const string &name) const{
+        auto it = locations.find(name);
+        return it != locations.end() ? it->second : -1;
+    }
+
+    // Typed handle for the per-frame path: set() through it is an array
+    // index, with no string hashing or driver lookup.
+    template <typename T>
+    Uniform<T> uniform(const string &name){
+        for (size_t i = 0; i < slotNames.size(); ++i) {
+            if (slotNames[i] == name) return {static_cast<int>(i)};
         }
-        while(getline(fShaderFile, fline)){
-            fragmentCode += fline + "\n";
+        slotNames.push_back(name);
+        slotLocations.push_back(location(name));
+        return {static_cast<int>(slotNames.size() - 1)};
+    }
+
+    void set(Uniform<bool> u, bool value) const{
+        glUniform1i(slotLocations[u.slot], (int)value);
+    }
+    void set(Uniform<int> u, int value) const{
+        glUniform1i(slotLocations[u.slot], value);
+    }
+    void set(Uniform<float> u, float value) const{
+        glUniform1f(slotLocations[u.slot], value);
+    }
+    void set(Uniform<glm::mat4> u, const glm::mat4 &mat) const{
+        glUniformMatrix4fv(slotLocations[u.slot], 1, GL_FALSE, glm::value_ptr(mat));
+    }
+    void set(Uniform<glm::vec2> u, const glm::vec2 &vec) const{
+        glUniform2fv(slotLocations[u.slot], 1, glm::value_ptr(vec));
+    }
+    void set(Uniform<glm::vec3> u, const glm::vec3 &vec) const{
+        glUniform3fv(slotLocations[u.slot], 1, glm::value_ptr(vec));
+    }
+
+    // Points the named uniform block at a buffer binding point. A program
+    // without the block is left alone.
+    void bindBlock(const string &name, GLuint binding){
+        blockBindings.emplace_back(name, binding);
+        bindBlocks();
+    }
+
+    // By-name setters for one-off use; these still hash the name.
+    void setBool(const string &name, bool value) const{
+        glUniform1i(location(name), (int)value);
+    }
+    void setInt(const string &name, int value) const{
+        glUniform1i(location(name), value);
+
+    }
+    void setFloat(const string &name, float value) const{
+        glUniform1f(location(name), value);
+
+    }
+    void setMat4(const std::string &name, const glm::mat4 &mat) const {
+        glUniformMatrix4fv(location(name),
+                           1, GL_FALSE, glm::value_ptr(mat));
+    }
+    void setVec2(const std::string &name, const glm::vec2 &vec) const {
+        glUniform2fv(location(name),
+                     1, glm::value_ptr(vec));
+    }
+    void setVec3(const std::string &name, const glm::vec3 &vec) const {
+        glUniform3fv(location(name),
+                     1, glm::value_ptr(vec));
+    }
+
+private:
+    // Links the sources into a new `program`, straight from the binary cache
+    // when it holds a match and `cached` is set. The program is created even
+    // if compiling or linking fails; the return value says whether it is
+    // usable.
+    static bool buildProgram(const string &vertexCode, const string &fragmentCode, unsigned int &program,
+                             bool cached = true){
+        const uint64_t key = cached ? programCacheKey(vertexCode, fragmentCode) : 0;
+        program = glCreateProgram();
+        if (cached) {
+            if (loadProgramBinary(program, key)) return true;
+            // A rejected binary can leave state behind, so start clean
+            glDeleteProgram(program);
+            program = glCreateProgram();
         }
-        vShaderFile.close();
-        fShaderFile.close();
 
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
@@ -49,6 +160,7 @@ public:
         //Compile retrieved shader files
         unsigned int vertex, fragment;
         int success;
+        bool ok = true;
         char infoLog[512];
 
         vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -59,6 +171,7 @@ public:
         {
             glGetShaderInfoLog(vertex, 512, nullptr, infoLog);
             cerr << "Vertex Shader Compilation Failed\n" << infoLog << std::endl;
+            ok = false;
         };
 
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
@@ -70,44 +183,66 @@ public:
         {
             glGetShaderInfoLog(fragment, 512, nullptr, infoLog);
             cerr << "Fragment Shader Compilation Failed\n" << infoLog << std::endl;
+            ok = false;
         };
-        ID = glCreateProgram();
 
-        glAttachShader(ID,vertex);
-        glAttachShader(ID,fragment);
-        glLinkProgram(ID);
-        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        glAttachShader(program,vertex);
+        glAttachShader(program,fragment);
+        if (cached && programBinariesSupported()) glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
         if(!success)
         {
-            glGetProgramInfoLog(ID, 512, nullptr, infoLog);
+            glGetProgramInfoLog(program, 512, nullptr, infoLog);
             cerr << "Linking Failed\n" << infoLog << std::endl;
+            ok = false;
         }
+        glDetachShader(program, vertex);
+        glDetachShader(program, fragment);
         glDeleteShader(vertex);
         glDeleteShader(fragment);
 
+        if (ok && cached) saveProgramBinary(program, key);
+        return ok;
     }
 
-    void use()const{
-        glUseProgram(ID);
-    }
-    void setBool(const string &name, bool value) const{
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    // Reads every active uniform of the linked program and re-resolves the
+    // handle slots against it.
+    void cacheUniforms(){
+        locations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        vector<char> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, static_cast<GLuint>(i), maxLength, &length, &size, &type, buffer.data());
+            string name(buffer.data(), length);
+            GLint loc = glGetUniformLocation(ID, name.c_str());
+            if (loc < 0) continue; // block members have no location
+            // Arrays are reported as "name[0]"; accept the bare name too
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+                locations[name.substr(0, name.size() - 3)] = loc;
+            }
+            locations[name] = loc;
+        }
+        for (size_t i = 0; i < slotNames.size(); ++i) slotLocations[i] = location(slotNames[i]);
     }
-    void setInt(const string &name, int value) const{
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
 
+    void bindBlocks() const{
+        for (const auto &b : blockBindings) {
+            GLuint index = glGetUniformBlockIndex(ID, b.first.c_str());
+            if (index != GL_INVALID_INDEX) glUniformBlockBinding(ID, index, b.second);
+        }
     }
-    void setFloat(const string &name, float value) const{
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
 
-    }
-    void setMat4(const std::string &name, const glm::mat4 &mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()),
-                           1, GL_FALSE, glm::value_ptr(mat));
-    }
-    void setVec3(const std::string &name, const glm::vec3 &vec) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()),
-                     1, glm::value_ptr(vec));
-    }
+    string vertexFile, fragmentFile;
+    vector<string> files;
 
+    unordered_map<string, GLint> locations; // active uniforms by name
+    vector<string> slotNames;               // one per handed-out Uniform
+    vector<GLint> slotLocations;
+    vector<pair<string, GLuint>> blockBindings;
 };
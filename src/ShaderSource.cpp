@@ -0,0 +1,92 @@
+#include "ShaderSource.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include "EmbeddedShaders.h"
+
+namespace {
+
+// Deep enough for any sane layering; stops include cycles.
+constexpr int MAX_INCLUDE_DEPTH = 16;
+
+std::string &directory() {
+    static std::string dir;
+    return dir;
+}
+
+bool readRaw(const std::string &name, std::string &text) {
+    if (!directory().empty()) {
+        std::ifstream in(directory() + "/" + name, std::ios::binary);
+        if (!in) return false;
+        text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+    for (const EmbeddedShader &shader : EMBEDDED_SHADERS) {
+        if (shader.name == name) {
+            text.assign(shader.source.data(), shader.source.size());
+            return true;
+        }
+    }
+    return false;
+}
+
+// The quoted file name of an `#include "..."` line, or empty.
+std::string includeTarget(const std::string &line) {
+    size_t p = line.find_first_not_of(" \t");
+    if (p == std::string::npos || line.compare(p, 8, "#include") != 0) return {};
+    size_t open = line.find('"', p + 8);
+    size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+    if (close == std::string::npos) return {};
+    return line.substr(open + 1, close - open - 1);
+}
+
+bool expand(const std::string &name, int depth, std::vector<std::string> &files, std::string &out) {
+    if (depth > MAX_INCLUDE_DEPTH) {
+        std::cerr << "Shader includes nested too deeply at " << name << "\n";
+        return false;
+    }
+    std::string text;
+    if (!readRaw(name, text)) {
+        std::cerr << "Could not read shader " << name << "\n";
+        return false;
+    }
+    const size_t stringNumber = files.size();
+    files.push_back(name);
+
+    std::istringstream lines(text);
+    std::string line;
+    for (int number = 1; std::getline(lines, line); ++number) {
+        std::string target = includeTarget(line);
+        if (target.empty()) {
+            out += line;
+            out += '\n';
+            continue;
+        }
+        if (std::find(files.begin(), files.end(), target) == files.end()) {
+            out += "#line 1 " + std::to_string(files.size()) + "\n";
+            if (!expand(target, depth + 1, files, out)) return false;
+        }
+        out += "#line " + std::to_string(number + 1) + " " + std::to_string(stringNumber) + "\n";
+    }
+    return true;
+}
+
+} // namespace
+
+void setShaderDirectory(const std::string &dir) {
+    directory() = dir;
+}
+
+const std::string &shaderDirectory() {
+    return directory();
+}
+
+bool loadShaderSource(const std::string &name, std::string &source, std::vector<std::string> *files) {
+    std::vector<std::string> seen;
+    source.clear();
+    bool ok = expand(name, 0, seen, source);
+    if (files) *files = std::move(seen);
+    return ok;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// GLSL sources by file name ("gridvert.glsl"). They come from the copies
+// embedded at build time, or from a directory on disk when one is set, so
+// shaders can be edited without rebuilding.
+//
+// A line `#include "name.glsl"` is replaced by that file, once per shader
+// even if several files include it, and framed with #line directives so
+// compiler messages still point at the right file (string 0 is `name`,
+// includes are numbered in the order they are first met).
+
+// Empty (the default) uses the embedded sources.
+void setShaderDirectory(const std::string &directory);
+const std::string &shaderDirectory();
+
+// Loads `name` with its includes expanded. `files`, if given, receives
+// every file the result was built from, `name` first.
+bool loadShaderSource(const std::string &name, std::string &source,
+                      std::vector<std::string> *files = nullptr);
@@ -0,0 +1,163 @@
+#include "ShaderWatcher.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "Shader.h"
+#include "ShaderSource.h"
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+// How long the worker sleeps between checks, which also bounds how long
+// stop() waits for it.
+constexpr int POLL_INTERVAL_MS = 250;
+// Editors often save in several steps; changes this close together are
+// handled as one.
+constexpr int SETTLE_MS = 50;
+}
+
+ShaderWatcher::~ShaderWatcher() {
+    stop();
+}
+
+void ShaderWatcher::watch(Shader &shader) {
+    entries.push_back({&shader, shader.vertexName(), shader.fragmentName(), shader.sourceFiles()});
+}
+
+void ShaderWatcher::start(const std::string &dir) {
+    stop();
+    directory = dir;
+    stopping = false;
+
+#ifdef __linux__
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd >= 0 &&
+        inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        close(inotifyFd);
+        inotifyFd = -1;
+    }
+#endif
+    if (inotifyFd < 0) {
+        // Baseline times, so only later edits count
+        fileTimes.clear();
+        std::vector<std::string> ignored;
+        scanFileTimes(ignored);
+    }
+
+    worker = std::thread(&ShaderWatcher::run, this);
+    std::cout << "Watching " << directory << " for shader changes\n";
+}
+
+void ShaderWatcher::stop() {
+    stopping = true;
+    if (worker.joinable()) worker.join();
+#ifdef __linux__
+    if (inotifyFd >= 0) close(inotifyFd);
+#endif
+    inotifyFd = -1;
+}
+
+void ShaderWatcher::run() {
+    while (!stopping) {
+        std::vector<std::string> changed = inotifyFd >= 0 ? waitForInotify() : waitForPoll();
+        if (!changed.empty()) reload(changed);
+    }
+}
+
+// Names of files written in the directory since the last call; waits up
+// to POLL_INTERVAL_MS for the first one.
+std::vector<std::string> ShaderWatcher::waitForInotify() {
+    std::vector<std::string> changed;
+#ifdef __linux__
+    pollfd pfd{inotifyFd, POLLIN, 0};
+    int timeout = POLL_INTERVAL_MS;
+    alignas(inotify_event) char buffer[4096];
+    while (poll(&pfd, 1, timeout) > 0) {
+        ssize_t n;
+        while ((n = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (char *p = buffer; p < buffer + n;) {
+                auto *event = reinterpret_cast<inotify_event *>(p);
+                if (event->len > 0) changed.emplace_back(event->name);
+                p += sizeof(inotify_event) + event->len;
+            }
+        }
+        timeout = SETTLE_MS;
+    }
+#endif
+    return changed;
+}
+
+// Adds the watched files whose modification time moved since the last scan.
+void ShaderWatcher::scanFileTimes(std::vector<std::string> &changed) {
+    for (const Entry &entry : entries) {
+        for (const std::string &file : entry.files) {
+            std::error_code error;
+            auto time = std::filesystem::last_write_time(directory + "/" + file, error);
+            if (error) continue;
+            auto it = fileTimes.find(file);
+            if (it == fileTimes.end()) {
+                fileTimes.emplace(file, time);
+            } else if (it->second != time) {
+                it->second = time;
+                changed.push_back(file);
+            }
+        }
+    }
+}
+
+std::vector<std::string> ShaderWatcher::waitForPoll() {
+    std::vector<std::string> changed;
+    std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+    scanFileTimes(changed);
+    if (!changed.empty()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MS));
+        scanFileTimes(changed);
+    }
+    return changed;
+}
+
+void ShaderWatcher::reload(const std::vector<std::string> &changed) {
+    for (Entry &entry : entries) {
+        bool affected = std::any_of(entry.files.begin(), entry.files.end(), [&](const std::string &f) {
+            return std::find(changed.begin(), changed.end(), f) != changed.end();
+        });
+        if (!affected) continue;
+
+        Pending update{entry.shader, {}, {}};
+        std::vector<std::string> vertexFiles, fragmentFiles;
+        if (!loadShaderSource(entry.vertexName, update.vertexCode, &vertexFiles) ||
+            !loadShaderSource(entry.fragmentName, update.fragmentCode, &fragmentFiles)) {
+            continue; // half-written or deleted; the next change retries
+        }
+        // An edit may have added or dropped includes
+        entry.files = vertexFiles;
+        for (const std::string &f : fragmentFiles) {
+            if (std::find(entry.files.begin(), entry.files.end(), f) == entry.files.end()) entry.files.push_back(f);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto same = std::find_if(pending.begin(), pending.end(), [&](const Pending &p) { return p.shader == entry.shader; });
+        if (same != pending.end()) *same = std::move(update);
+        else pending.push_back(std::move(update));
+    }
+}
+
+void ShaderWatcher::apply() {
+    std::vector<Pending> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.empty()) return;
+        ready.swap(pending);
+    }
+    for (const Pending &p : ready) {
+        std::string name = p.shader->vertexName() + " + " + p.shader->fragmentName();
+        if (p.shader->relink(p.vertexCode, p.fragmentCode)) {
+            std::cout << "Reloaded " << name << "\n";
+        } else {
+            std::cerr << "Keeping the previous " << name << "\n";
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Shader;
+
+// Reloads shaders while the sim runs. A worker thread watches the shader
+// directory (inotify on Linux, polling file times elsewhere or if inotify
+// is unavailable), and when a file changes it re-reads and expands the
+// sources of every shader that uses it. apply(), called on the GL thread
+// between frames, relinks those shaders; one that fails to compile keeps
+// its previous program.
+//
+//     watcher.watch(gridShader);   // all watch() calls before start()
+//     watcher.start(shaderDirectory());
+//     ... each frame: watcher.apply();
+class ShaderWatcher {
+public:
+    ShaderWatcher() = default;
+    ~ShaderWatcher();
+
+    ShaderWatcher(const ShaderWatcher &) = delete;
+    ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+    void watch(Shader &shader);
+    void start(const std::string &directory);
+    void stop();
+
+    // Relinks the shaders whose new sources are ready. GL thread only.
+    void apply();
+
+private:
+    struct Entry {
+        Shader *shader;
+        std::string vertexName, fragmentName;
+        std::vector<std::string> files; // everything the sources include
+    };
+    struct Pending {
+        Shader *shader;
+        std::string vertexCode, fragmentCode;
+    };
+
+    void run();
+    std::vector<std::string> waitForInotify();
+    std::vector<std::string> waitForPoll();
+    void scanFileTimes(std::vector<std::string> &changed);
+    void reload(const std::vector<std::string> &changed);
+
+    std::string directory;
+    std::vector<Entry> entries; // owned by the worker once started
+
+    int inotifyFd = -1;
+    std::map<std::string, std::filesystem::file_time_type> fileTimes; // polling only
+
+    std::mutex mutex;
+    std::vector<Pending> pending;
+
+    std::atomic<bool> stopping{false};
+    std::thread worker;
+};
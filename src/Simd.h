@@ -0,0 +1,115 @@
+#pragma once
+
+// Minimal 4-wide float vector over SSE, NEON or plain scalars, just enough
+// for the potential kernels.
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SIMD_SSE 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SIMD_NEON 1
+#else
+#include <cmath>
+#endif
+
+struct float4 {
+#if SIMD_SSE
+    __m128 v;
+#elif SIMD_NEON
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+};
+
+inline float4 splat4(float s) {
+#if SIMD_SSE
+    return {_mm_set1_ps(s)};
+#elif SIMD_NEON
+    return {vdupq_n_f32(s)};
+#else
+    return {{s, s, s, s}};
+#endif
+}
+
+// (a, a + d, a + 2d, a + 3d)
+inline float4 ramp4(float a, float d) {
+#if SIMD_SSE
+    return {_mm_setr_ps(a, a + d, a + 2 * d, a + 3 * d)};
+#elif SIMD_NEON
+    float lanes[4] = {a, a + d, a + 2 * d, a + 3 * d};
+    return {vld1q_f32(lanes)};
+#else
+    return {{a, a + d, a + 2 * d, a + 3 * d}};
+#endif
+}
+
+inline float4 load4(const float *p) {
+#if SIMD_SSE
+    return {_mm_loadu_ps(p)};
+#elif SIMD_NEON
+    return {vld1q_f32(p)};
+#else
+    return {{p[0], p[1], p[2], p[3]}};
+#endif
+}
+
+inline void store4(float *p, float4 a) {
+#if SIMD_SSE
+    _mm_storeu_ps(p, a.v);
+#elif SIMD_NEON
+    vst1q_f32(p, a.v);
+#else
+    for (int i = 0; i < 4; ++i) p[i] = a.v[i];
+#endif
+}
+
+inline float4 operator+(float4 a, float4 b) {
+#if SIMD_SSE
+    return {_mm_add_ps(a.v, b.v)};
+#elif SIMD_NEON
+    return {vaddq_f32(a.v, b.v)};
+#else
+    return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+#endif
+}
+
+inline float4 operator-(float4 a, float4 b) {
+#if SIMD_SSE
+    return {_mm_sub_ps(a.v, b.v)};
+#elif SIMD_NEON
+    return {vsubq_f32(a.v, b.v)};
+#else
+    return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}};
+#endif
+}
+
+inline float4 operator*(float4 a, float4 b) {
+#if SIMD_SSE
+    return {_mm_mul_ps(a.v, b.v)};
+#elif SIMD_NEON
+    return {vmulq_f32(a.v, b.v)};
+#else
+    return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+#endif
+}
+
+// 1/sqrt(x) from the hardware estimate refined with Newton-Raphson to
+// about 22 bits, plenty for a displacement that's drawn on screen.
+inline float4 rsqrt4(float4 x) {
+#if SIMD_SSE
+    __m128 y = _mm_rsqrt_ps(x.v);
+    __m128 yy = _mm_mul_ps(y, y);
+    __m128 half = _mm_mul_ps(_mm_set1_ps(0.5f), x.v);
+    return {_mm_mul_ps(y, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(half, yy)))};
+#elif SIMD_NEON
+    float32x4_t y = vrsqrteq_f32(x.v);
+    y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(x.v, y), y));
+    y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(x.v, y), y));
+    return {y};
+#else
+    return {{1.0f / std::sqrt(x.v[0]), 1.0f / std::sqrt(x.v[1]),
+             1.0f / std::sqrt(x.v[2]), 1.0f / std::sqrt(x.v[3])}};
+#endif
+}
@@ -0,0 +1,267 @@
+#include "Snapshot.h"
+#include "SnapshotCodec.h"
+#include "SnapshotReader.h"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+void BodyColumns::resize(size_t n) {
+    px.resize(n); py.resize(n); pz.resize(n);
+    vx.resize(n); vy.resize(n); vz.resize(n);
+    mass.resize(n);
+}
+
+BodyColumnsView BodyColumns::view() const {
+    return {{px.data(), py.data(), pz.data(), vx.data(), vy.data(), vz.data(), mass.data()}, size()};
+}
+
+SnapshotWriter::SnapshotWriter() = default;
+
+SnapshotWriter::~SnapshotWriter() {
+    close();
+}
+
+bool SnapshotWriter::open(const std::string &path, const BodyAttributes &attributes, uint32_t stride,
+                          const SnapshotEncodingOptions &encoding) {
+    close();
+
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Could not open snapshot file " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    bodyCount = static_cast<uint32_t>(attributes.size());
+    stepStride = stride > 0 ? stride : 1;
+    offset = 0;
+    index.clear();
+
+    SnapshotFileHeader header{};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.bodyCount = bodyCount;
+    header.stepStride = stepStride;
+    header.fieldCount = SNAPSHOT_FIELD_COUNT;
+    setEncoding(encoding, header);
+
+    const size_t column = bodyCount * sizeof(float);
+    struct iovec iov[6] = {
+            {&header, sizeof(header)},
+            {const_cast<float *>(attributes.radius.data()), column},
+            {const_cast<float *>(attributes.colorR.data()), column},
+            {const_cast<float *>(attributes.colorG.data()), column},
+            {const_cast<float *>(attributes.colorB.data()), column},
+            {const_cast<uint32_t *>(attributes.bodyType.data()), bodyCount * sizeof(uint32_t)},
+    };
+    if (!writeAll(iov, 6)) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool SnapshotWriter::resume(const std::string &path, const BodyAttributes &attributes, uint32_t stride,
+                            const SnapshotEncodingOptions &encoding, uint64_t step) {
+    close();
+
+    struct stat st{};
+    if (::stat(path.c_str(), &st) != 0 && errno == ENOENT) return open(path, attributes, stride, encoding);
+
+    SnapshotReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "Not overwriting " << path << " on restart\n";
+        return false;
+    }
+
+    SnapshotFileHeader expected{};
+    expected.bodyCount = static_cast<uint32_t>(attributes.size());
+    expected.stepStride = stride > 0 ? stride : 1;
+    setEncoding(encoding, expected);
+    const SnapshotFileHeader &found = reader.header();
+    if (found.bodyCount != expected.bodyCount || found.stepStride != expected.stepStride
+        || found.encoding != expected.encoding || found.keyframeInterval != expected.keyframeInterval
+        || found.positionError != expected.positionError || found.velocityError != expected.velocityError) {
+        std::cerr << "Snapshot file " << path << " was written with other bodies or settings;"
+                  << " not overwriting it on restart\n";
+        return false;
+    }
+
+    // Keep the chunks before the restored step; the new run writes that
+    // step again, starting quantized files with a keyframe.
+    index.clear();
+    uint64_t end = sizeof(SnapshotFileHeader)
+                   + uint64_t(expected.bodyCount) * (4 * sizeof(float) + sizeof(uint32_t));
+    for (size_t i = 0; i < reader.chunkCount() && reader.chunk(i).step < step; ++i) {
+        index.push_back(reader.chunk(i));
+        end = reader.chunk(i).offset + reader.chunk(i).bytes;
+    }
+    reader.close();
+
+    fd = ::open(path.c_str(), O_WRONLY);
+    if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(end)) != 0
+        || ::lseek(fd, static_cast<off_t>(end), SEEK_SET) < 0) {
+        std::cerr << "Could not resume snapshot file " << path << ": " << std::strerror(errno) << "\n";
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+        index.clear();
+        return false;
+    }
+    bodyCount = expected.bodyCount;
+    stepStride = expected.stepStride;
+    offset = end;
+    return true;
+}
+
+void SnapshotWriter::setEncoding(const SnapshotEncodingOptions &encoding, SnapshotFileHeader &header) {
+    if (encoding.quantized()) {
+        header.encoding = static_cast<uint32_t>(SnapshotEncoding::QuantizedDelta);
+        header.keyframeInterval = encoding.keyframeInterval;
+        header.positionError = encoding.positionError;
+        header.velocityError = encoding.velocityError;
+        encoder = std::make_unique<SnapshotEncoder>(encoding);
+    } else {
+        header.encoding = static_cast<uint32_t>(SnapshotEncoding::Raw);
+        encoder.reset();
+    }
+}
+
+bool SnapshotWriter::write(uint64_t step, double time, const BodyColumns &columns) {
+    if (fd < 0) return false;
+    if (columns.size() != bodyCount) {
+        std::cerr << "Snapshot body count changed mid-run (" << columns.size()
+                  << " vs " << bodyCount << ")\n";
+        return false;
+    }
+    if (encoder) return writeEncoded(step, time, columns.view());
+
+    const size_t column = bodyCount * sizeof(float);
+
+    SnapshotChunkHeader header{};
+    header.magic = SNAPSHOT_CHUNK_MAGIC;
+    header.step = step;
+    header.time = time;
+    header.payloadBytes = column * SNAPSHOT_FIELD_COUNT;
+
+    SnapshotIndexEntry entry{step, time, offset, sizeof(header) + header.payloadBytes};
+
+    struct iovec iov[1 + SNAPSHOT_FIELD_COUNT] = {
+            {&header, sizeof(header)},
+            {const_cast<float *>(columns.px.data()), column},
+            {const_cast<float *>(columns.py.data()), column},
+            {const_cast<float *>(columns.pz.data()), column},
+            {const_cast<float *>(columns.vx.data()), column},
+            {const_cast<float *>(columns.vy.data()), column},
+            {const_cast<float *>(columns.vz.data()), column},
+            {const_cast<float *>(columns.mass.data()), column},
+    };
+    if (!writeAll(iov, 1 + SNAPSHOT_FIELD_COUNT)) return false;
+
+    index.push_back(entry);
+    return true;
+}
+
+bool SnapshotWriter::writeChunk(const void *chunk, size_t bytes) {
+    if (fd < 0) return false;
+
+    SnapshotChunkHeader header;
+    std::memcpy(&header, chunk, sizeof(header));
+
+    if (encoder) {
+        const float *payload = reinterpret_cast<const float *>(static_cast<const char *>(chunk) + sizeof(header));
+        BodyColumnsView view{};
+        view.count = bodyCount;
+        for (uint32_t f = 0; f < SNAPSHOT_FIELD_COUNT; ++f) view.field[f] = payload + size_t(f) * bodyCount;
+        return writeEncoded(header.step, header.time, view);
+    }
+
+    SnapshotIndexEntry entry{header.step, header.time, offset, bytes};
+
+    struct iovec iov[1] = {{const_cast<void *>(chunk), bytes}};
+    if (!writeAll(iov, 1)) return false;
+
+    index.push_back(entry);
+    return true;
+}
+
+bool SnapshotWriter::writeEncoded(uint64_t step, double time, const BodyColumnsView &view) {
+    encoder->encode(step, time, view, encoded);
+    SnapshotIndexEntry entry{step, time, offset, encoded.size()};
+
+    struct iovec iov[1] = {{encoded.data(), encoded.size()}};
+    if (!writeAll(iov, 1)) return false;
+
+    index.push_back(entry);
+    return true;
+}
+
+size_t SnapshotWriter::chunkBytes() const {
+    return sizeof(SnapshotChunkHeader) + size_t(bodyCount) * sizeof(float) * SNAPSHOT_FIELD_COUNT;
+}
+
+void SnapshotWriter::encodeChunk(uint64_t step, double time, const BodyColumns &columns, void *dst) {
+    const size_t column = columns.size() * sizeof(float);
+
+    SnapshotChunkHeader header{};
+    header.magic = SNAPSHOT_CHUNK_MAGIC;
+    header.step = step;
+    header.time = time;
+    header.payloadBytes = column * SNAPSHOT_FIELD_COUNT;
+
+    char *out = static_cast<char *>(dst);
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    for (const std::vector<float> *field : {&columns.px, &columns.py, &columns.pz,
+                                            &columns.vx, &columns.vy, &columns.vz, &columns.mass}) {
+        std::memcpy(out, field->data(), column);
+        out += column;
+    }
+}
+
+void SnapshotWriter::close() {
+    if (fd < 0) return;
+
+    SnapshotFileFooter footer{};
+    footer.indexOffset = offset;
+    footer.chunkCount = index.size();
+    std::memcpy(footer.magic, SNAPSHOT_MAGIC, sizeof(footer.magic));
+
+    struct iovec iov[2] = {
+            {index.data(), index.size() * sizeof(SnapshotIndexEntry)},
+            {&footer, sizeof(footer)},
+    };
+    writeAll(iov, 2);
+
+    ::close(fd);
+    fd = -1;
+    index.clear();
+}
+
+// writev may stop short (signals, pipes, full disks); keep going until every
+// iovec is drained.
+bool SnapshotWriter::writeAll(struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = ::writev(fd, iov, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Snapshot write failed: " << std::strerror(errno) << "\n";
+            return false;
+        }
+        offset += static_cast<uint64_t>(n);
+
+        while (count > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+            n -= static_cast<ssize_t>(iov->iov_len);
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + n;
+            iov->iov_len -= static_cast<size_t>(n);
+        }
+    }
+    return true;
+}
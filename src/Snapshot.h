@@ -0,0 +1,167 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Trajectory file layout (little-endian, native float/double):
+//
+//   SnapshotFileHeader
+//   static block   radius[N] colorR[N] colorG[N] colorB[N] bodyType[N]
+//   chunk 0..M-1   SnapshotChunkHeader, then the payload. Raw files store
+//                  px[N] py[N] pz[N] vx[N] vy[N] vz[N] mass[N]; quantized
+//                  files store the streams described in SnapshotCodec.h
+//   index          SnapshotIndexEntry[M]
+//   SnapshotFileFooter
+//
+// Every column is a contiguous float block, so a reader can pull e.g. all
+// x positions of one step with a single read. The index and footer are only
+// written on close(); chunks are self-describing so a file from a run that
+// died can still be recovered by walking the chunk headers.
+
+constexpr char     SNAPSHOT_MAGIC[8]    = {'N', 'B', 'S', 'N', 'A', 'P', 0, 0};
+constexpr uint32_t SNAPSHOT_VERSION     = 2;
+constexpr uint32_t SNAPSHOT_CHUNK_MAGIC = 0x4B4E4843; // "CHNK"
+constexpr uint32_t SNAPSHOT_FIELD_COUNT = 7;          // px py pz vx vy vz mass
+
+// Chunk flags
+constexpr uint32_t SNAPSHOT_CHUNK_KEYFRAME = 1u << 0; // decodable without earlier chunks
+constexpr uint32_t SNAPSHOT_CHUNK_RAW      = 1u << 1; // float columns in a quantized file
+
+enum class SnapshotEncoding : uint32_t {
+    Raw = 0,            // float columns, every chunk is a keyframe
+    QuantizedDelta = 1, // see SnapshotCodec.h
+};
+
+struct SnapshotFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t bodyCount;
+    uint32_t stepStride;   // a chunk is written every stepStride steps
+    uint32_t fieldCount;
+    uint32_t encoding;         // SnapshotEncoding
+    uint32_t keyframeInterval; // chunks between keyframes (quantized only)
+    float    positionError;    // max absolute error (quantized only)
+    float    velocityError;
+    uint32_t reserved[2];
+};
+
+struct SnapshotChunkHeader {
+    uint32_t magic;
+    uint32_t flags;
+    uint64_t step;
+    double   time;
+    uint64_t payloadBytes; // bytes following this header
+};
+
+struct SnapshotIndexEntry {
+    uint64_t step;
+    double   time;
+    uint64_t offset;       // file offset of the chunk header
+    uint64_t bytes;        // header + payload
+};
+
+struct SnapshotFileFooter {
+    uint64_t indexOffset;
+    uint64_t chunkCount;
+    char     magic[8];
+};
+
+static_assert(sizeof(SnapshotFileHeader) == 48, "header must stay packed");
+static_assert(sizeof(SnapshotChunkHeader) == 32, "chunk header must stay packed");
+static_assert(sizeof(SnapshotIndexEntry) == 32, "index entry must stay packed");
+static_assert(sizeof(SnapshotFileFooter) == 24, "footer must stay packed");
+
+// Read-only pointers to the columns of one step, in file order.
+struct BodyColumnsView {
+    const float *field[SNAPSHOT_FIELD_COUNT];
+    size_t count;
+};
+
+// Per-step body state as structure-of-arrays.
+struct BodyColumns {
+    std::vector<float> px, py, pz;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> mass;
+
+    void resize(size_t n);
+    size_t size() const { return mass.size(); }
+    BodyColumnsView view() const;
+};
+
+// Per-body data that never changes during a run.
+struct BodyAttributes {
+    std::vector<float> radius;
+    std::vector<float> colorR, colorG, colorB;
+    std::vector<uint32_t> bodyType;
+
+    size_t size() const { return radius.size(); }
+};
+
+// Lossy encoding settings. A zero error bound selects the raw encoding.
+struct SnapshotEncodingOptions {
+    float positionError = 0.0f;
+    float velocityError = 0.0f;
+    uint32_t keyframeInterval = 32;
+
+    bool quantized() const { return positionError > 0.0f && velocityError > 0.0f; }
+};
+
+class SnapshotEncoder;
+
+class SnapshotWriter {
+public:
+    SnapshotWriter();
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter &) = delete;
+    SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+    bool open(const std::string &path, const BodyAttributes &attributes, uint32_t stepStride,
+              const SnapshotEncodingOptions &encoding = {});
+
+    // Continues the file at `path` from a restarted run: chunks before
+    // `step` are kept, everything from there on (and the old index) is cut
+    // off, and writing carries on at the end. The file must have been
+    // written with the same bodies and settings; it is left untouched
+    // otherwise. A missing file is simply created.
+    bool resume(const std::string &path, const BodyAttributes &attributes, uint32_t stepStride,
+                const SnapshotEncodingOptions &encoding, uint64_t step);
+
+    // Appends one chunk. Raw columns are handed to the kernel with writev,
+    // so nothing is copied on our side; quantized files encode first.
+    bool write(uint64_t step, double time, const BodyColumns &columns);
+
+    // Appends a raw chunk that is already laid out in memory, header
+    // included, re-encoding it if the file is quantized.
+    bool writeChunk(const void *chunk, size_t bytes);
+
+    // Bytes of one raw chunk (header + payload) for the current body count.
+    size_t chunkBytes() const;
+
+    // Lays out a complete chunk for `columns` at `dst`, which must hold
+    // chunkBytes() bytes.
+    static void encodeChunk(uint64_t step, double time, const BodyColumns &columns, void *dst);
+
+    // Writes the index and footer and closes the file.
+    void close();
+
+    bool isOpen() const { return fd >= 0; }
+    uint32_t bodies() const { return bodyCount; }
+    bool due(uint64_t step) const { return isOpen() && step % stepStride == 0; }
+
+private:
+    void setEncoding(const SnapshotEncodingOptions &encoding, SnapshotFileHeader &header);
+    bool writeAll(struct iovec *iov, int count);
+    bool writeEncoded(uint64_t step, double time, const BodyColumnsView &view);
+
+    int fd = -1;
+    uint32_t bodyCount = 0;
+    uint32_t stepStride = 1;
+    uint64_t offset = 0;
+    std::vector<SnapshotIndexEntry> index;
+
+    std::unique_ptr<SnapshotEncoder> encoder; // null for raw files
+    std::vector<uint8_t> encoded;
+};
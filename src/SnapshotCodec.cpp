@@ -0,0 +1,450 @@
+#include "SnapshotCodec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include "Morton.h"
+
+namespace {
+
+// Residual symbols are bit lengths 0..64 of the zigzagged value.
+constexpr int      RESIDUAL_SYMBOLS = 65;
+constexpr uint32_t PROB_BITS  = 12;
+constexpr uint32_t PROB_SCALE = 1u << PROB_BITS;
+constexpr uint32_t RANS_L     = 1u << 23; // lower bound of the normalized rANS state
+
+inline uint64_t zigzag(int64_t v) { return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63); }
+inline int64_t unzigzag(uint64_t u) { return static_cast<int64_t>(u >> 1) ^ -static_cast<int64_t>(u & 1); }
+inline int bitLength(uint64_t v) { return v ? 64 - __builtin_clzll(v) : 0; }
+
+// False when v is not finite or lands outside the int32 grid, where the
+// error bound can no longer be kept.
+bool quantize(float v, double invStep, int32_t &out) {
+    double q = std::nearbyint(static_cast<double>(v) * invStep);
+    if (!(q >= -2147483647.0 && q <= 2147483647.0)) return false;
+    out = static_cast<int32_t>(q);
+    return true;
+}
+
+template <typename T>
+void appendPod(std::vector<uint8_t> &out, const T &value) {
+    const auto *bytes = reinterpret_cast<const uint8_t *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+bool readPod(const uint8_t *&p, const uint8_t *end, T &value) {
+    if (static_cast<size_t>(end - p) < sizeof(T)) return false;
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t> &out) : out(out) {}
+
+    void put(uint64_t v, int n) {
+        while (n > 0) {
+            int take = n < 32 ? n : 32;
+            acc |= (v & ((1ull << take) - 1)) << bits;
+            bits += take;
+            v >>= take;
+            n -= take;
+            while (bits >= 8) {
+                out.push_back(static_cast<uint8_t>(acc));
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+    }
+
+    void flush() {
+        if (bits > 0) out.push_back(static_cast<uint8_t>(acc));
+        acc = 0;
+        bits = 0;
+    }
+
+private:
+    std::vector<uint8_t> &out;
+    uint64_t acc = 0;
+    int bits = 0;
+};
+
+class BitReader {
+public:
+    BitReader(const uint8_t *p, const uint8_t *end) : p(p), end(end) {}
+
+    uint64_t get(int n) {
+        uint64_t v = 0;
+        int shift = 0;
+        while (n > 0) {
+            int take = n < 32 ? n : 32;
+            while (bits <= 56 && p < end) {
+                acc |= static_cast<uint64_t>(*p++) << bits;
+                bits += 8;
+            }
+            if (bits < take) {
+                overrun = true;
+                return 0;
+            }
+            v |= (acc & ((1ull << take) - 1)) << shift;
+            acc >>= take;
+            bits -= take;
+            shift += take;
+            n -= take;
+        }
+        return v;
+    }
+
+    bool overrun = false;
+
+private:
+    const uint8_t *p, *end;
+    uint64_t acc = 0;
+    int bits = 0;
+};
+
+// Scale symbol counts to frequencies summing to PROB_SCALE, keeping every
+// used symbol at least 1.
+void normalizeFrequencies(const uint64_t counts[RESIDUAL_SYMBOLS], uint64_t total,
+                          uint16_t freq[RESIDUAL_SYMBOLS]) {
+    int64_t sum = 0;
+    for (int s = 0; s < RESIDUAL_SYMBOLS; ++s) {
+        uint64_t f = counts[s] ? std::max<uint64_t>(1, counts[s] * PROB_SCALE / total) : 0;
+        freq[s] = static_cast<uint16_t>(f);
+        sum += static_cast<int64_t>(f);
+    }
+    while (sum != PROB_SCALE) {
+        int best = 0;
+        for (int s = 1; s < RESIDUAL_SYMBOLS; ++s)
+            if (freq[s] > freq[best]) best = s;
+        if (sum > PROB_SCALE) {
+            // The largest entry is always > 1 while we overshoot.
+            --freq[best];
+            --sum;
+        } else {
+            ++freq[best];
+            ++sum;
+        }
+    }
+}
+
+void encodeStream(const std::vector<uint64_t> &values, std::vector<uint8_t> &out) {
+    const size_t n = values.size();
+
+    uint64_t counts[RESIDUAL_SYMBOLS] = {};
+    for (uint64_t v : values) ++counts[bitLength(v)];
+
+    uint16_t freq[RESIDUAL_SYMBOLS] = {};
+    if (n > 0) normalizeFrequencies(counts, n, freq);
+    uint32_t cum[RESIDUAL_SYMBOLS + 1] = {};
+    for (int s = 0; s < RESIDUAL_SYMBOLS; ++s) cum[s + 1] = cum[s] + freq[s];
+    for (uint16_t f : freq) appendPod(out, f);
+
+    // rANS runs back to front; the state emits at most two bytes per symbol.
+    std::vector<uint8_t> rans(2 * n + 8);
+    uint8_t *end = rans.data() + rans.size();
+    uint8_t *ptr = end;
+    uint32_t x = RANS_L;
+    for (size_t i = n; i-- > 0;) {
+        int s = bitLength(values[i]);
+        uint32_t f = freq[s];
+        uint32_t xMax = ((RANS_L >> PROB_BITS) << 8) * f;
+        while (x >= xMax) {
+            *--ptr = static_cast<uint8_t>(x);
+            x >>= 8;
+        }
+        x = ((x / f) << PROB_BITS) + (x % f) + cum[s];
+    }
+    ptr -= 4;
+    ptr[0] = static_cast<uint8_t>(x);
+    ptr[1] = static_cast<uint8_t>(x >> 8);
+    ptr[2] = static_cast<uint8_t>(x >> 16);
+    ptr[3] = static_cast<uint8_t>(x >> 24);
+
+    appendPod(out, static_cast<uint64_t>(end - ptr));
+    out.insert(out.end(), ptr, end);
+
+    // Extra bits: everything below the leading one.
+    std::vector<uint8_t> extra;
+    extra.reserve(n);
+    BitWriter bits(extra);
+    for (uint64_t v : values) {
+        int len = bitLength(v);
+        if (len > 1) bits.put(v, len - 1);
+    }
+    bits.flush();
+
+    appendPod(out, static_cast<uint64_t>(extra.size()));
+    out.insert(out.end(), extra.begin(), extra.end());
+}
+
+bool decodeStream(const uint8_t *&p, const uint8_t *end, size_t n, std::vector<uint64_t> &values) {
+    uint16_t freq[RESIDUAL_SYMBOLS];
+    for (uint16_t &f : freq)
+        if (!readPod(p, end, f)) return false;
+
+    // An empty stream is written with an all-zero table
+    uint32_t cum[RESIDUAL_SYMBOLS + 1] = {};
+    for (int s = 0; s < RESIDUAL_SYMBOLS; ++s) cum[s + 1] = cum[s] + freq[s];
+    if (cum[RESIDUAL_SYMBOLS] != (n > 0 ? PROB_SCALE : 0)) return false;
+
+    uint8_t slotSymbol[PROB_SCALE];
+    for (int s = 0; s < RESIDUAL_SYMBOLS; ++s)
+        std::fill(slotSymbol + cum[s], slotSymbol + cum[s + 1], static_cast<uint8_t>(s));
+
+    uint64_t ransBytes;
+    if (!readPod(p, end, ransBytes) || ransBytes < 4 || ransBytes > static_cast<uint64_t>(end - p)) return false;
+    const uint8_t *rp = p;
+    const uint8_t *rend = p + ransBytes;
+    p = rend;
+
+    uint64_t extraBytes;
+    if (!readPod(p, end, extraBytes) || extraBytes > static_cast<uint64_t>(end - p)) return false;
+    BitReader bits(p, p + extraBytes);
+    p += extraBytes;
+
+    uint32_t x = rp[0] | (rp[1] << 8) | (rp[2] << 16) | (static_cast<uint32_t>(rp[3]) << 24);
+    rp += 4;
+
+    values.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t slot = x & (PROB_SCALE - 1);
+        int s = slotSymbol[slot];
+        x = freq[s] * (x >> PROB_BITS) + slot - cum[s];
+        while (x < RANS_L) {
+            if (rp == rend) return false;
+            x = (x << 8) | *rp++;
+        }
+
+        if (s <= 1) values[i] = static_cast<uint64_t>(s);
+        else values[i] = (1ull << (s - 1)) | bits.get(s - 1);
+    }
+    return !bits.overrun;
+}
+
+} // namespace
+
+SnapshotCodecState::SnapshotCodecState(const SnapshotEncodingOptions &options)
+        : options(options),
+          positionStep(2.0 * options.positionError),
+          velocityStep(2.0 * options.velocityError)
+{
+}
+
+void SnapshotCodecState::resize(size_t n) {
+    for (auto &column : previous) column.assign(n, 0);
+    previousMass.assign(n, 0);
+    order.resize(n);
+    for (size_t i = 0; i < n; ++i) order[i] = static_cast<uint32_t>(i);
+    hasReference = false;
+}
+
+// Sort bodies along a Z-order curve over the quantized positions so
+// neighbours in the residual stream are neighbours in space. Expects
+// `previous` in body order and leaves it permuted into the new order.
+void SnapshotCodecState::updateOrder() {
+    const size_t n = order.size();
+    if (n == 0) return;
+
+    int64_t lo[3], shift[3];
+    for (int c = 0; c < 3; ++c) {
+        auto range = std::minmax_element(previous[c].begin(), previous[c].end());
+        lo[c] = *range.first;
+        uint64_t span = static_cast<uint64_t>(static_cast<int64_t>(*range.second) - lo[c]);
+        shift[c] = std::max(0, bitLength(span) - 21);
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t code = 0;
+        for (int c = 0; c < 3; ++c) {
+            uint64_t v = static_cast<uint64_t>(previous[c][i] - lo[c]) >> shift[c];
+            code |= spreadBits(v) << c;
+        }
+        keys[i] = {code, static_cast<uint32_t>(i)};
+    }
+    std::sort(keys.begin(), keys.end());
+    for (size_t k = 0; k < n; ++k) order[k] = keys[k].second;
+
+    std::vector<int32_t> permuted(n);
+    for (auto &column : previous) {
+        for (size_t k = 0; k < n; ++k) permuted[k] = column[order[k]];
+        column.swap(permuted);
+    }
+}
+
+SnapshotEncoder::SnapshotEncoder(const SnapshotEncodingOptions &options)
+        : SnapshotCodecState(options)
+{
+}
+
+void SnapshotEncoder::encode(uint64_t step, double time, const BodyColumnsView &columns,
+                             std::vector<uint8_t> &out) {
+    const size_t n = columns.count;
+    if (n != previousMass.size()) resize(n);
+
+    bool inRange = true;
+    for (int c = 0; c < 6; ++c) {
+        double invStep = 1.0 / (c < 3 ? positionStep : velocityStep);
+        quantized[c].resize(n);
+        for (size_t i = 0; i < n; ++i) inRange &= quantize(columns.field[c][i], invStep, quantized[c][i]);
+    }
+    if (!inRange) {
+        encodeRaw(step, time, columns, out);
+        return;
+    }
+
+    bool keyframe = !hasReference || chunkCount >= options.keyframeInterval;
+    chunkCount = keyframe ? 1 : chunkCount + 1;
+
+    out.assign(sizeof(SnapshotChunkHeader), 0);
+
+    for (int group = 0; group < 2; ++group) {
+        residuals.clear();
+        residuals.reserve(3 * n);
+        for (int c = group * 3; c < group * 3 + 3; ++c) {
+            const int32_t *q = quantized[c].data();
+            int32_t *ref = previous[c].data();
+            int64_t last = 0;
+            for (size_t k = 0; k < n; ++k) {
+                int64_t t = q[k];
+                if (!keyframe) {
+                    int32_t current = q[order[k]];
+                    t = static_cast<int64_t>(current) - ref[k];
+                    ref[k] = current;
+                }
+                residuals.push_back(zigzag(t - last));
+                last = t;
+            }
+        }
+        encodeStream(residuals, out);
+    }
+
+    residuals.resize(n);
+    const float *mass = columns.field[6];
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t bits;
+        std::memcpy(&bits, &mass[i], sizeof(bits));
+        residuals[i] = keyframe ? bits : bits ^ previousMass[i];
+        previousMass[i] = bits;
+    }
+    encodeStream(residuals, out);
+
+    if (keyframe) {
+        for (int c = 0; c < 6; ++c) previous[c].swap(quantized[c]);
+        updateOrder();
+    }
+    hasReference = true;
+
+    SnapshotChunkHeader header{};
+    header.magic = SNAPSHOT_CHUNK_MAGIC;
+    header.flags = keyframe ? SNAPSHOT_CHUNK_KEYFRAME : 0;
+    header.step = step;
+    header.time = time;
+    header.payloadBytes = out.size() - sizeof(header);
+    std::memcpy(out.data(), &header, sizeof(header));
+}
+
+// Stores the step as float columns, as in a raw file. The chunk stands on
+// its own, so the next one is forced to be a keyframe.
+void SnapshotEncoder::encodeRaw(uint64_t step, double time, const BodyColumnsView &columns,
+                                std::vector<uint8_t> &out) {
+    if (!warnedRange) {
+        std::cerr << "Snapshot values at step " << step << " do not fit the quantization grid;"
+                  << " writing raw chunks where needed\n";
+        warnedRange = true;
+    }
+    const size_t column = columns.count * sizeof(float);
+
+    SnapshotChunkHeader header{};
+    header.magic = SNAPSHOT_CHUNK_MAGIC;
+    header.flags = SNAPSHOT_CHUNK_KEYFRAME | SNAPSHOT_CHUNK_RAW;
+    header.step = step;
+    header.time = time;
+    header.payloadBytes = column * SNAPSHOT_FIELD_COUNT;
+
+    out.resize(sizeof(header) + header.payloadBytes);
+    std::memcpy(out.data(), &header, sizeof(header));
+    for (uint32_t f = 0; f < SNAPSHOT_FIELD_COUNT; ++f) {
+        std::memcpy(out.data() + sizeof(header) + f * column, columns.field[f], column);
+    }
+    hasReference = false;
+}
+
+SnapshotDecoder::SnapshotDecoder(const SnapshotEncodingOptions &options, size_t bodyCount)
+        : SnapshotCodecState(options), bodyCount(bodyCount)
+{
+    resize(bodyCount);
+}
+
+bool SnapshotDecoder::decode(const void *chunk, size_t bytes, BodyColumns &out) {
+    SnapshotChunkHeader header;
+    if (bytes < sizeof(header)) return false;
+    std::memcpy(&header, chunk, sizeof(header));
+    if (header.magic != SNAPSHOT_CHUNK_MAGIC || header.payloadBytes > bytes - sizeof(header)) return false;
+
+    bool keyframe = (header.flags & SNAPSHOT_CHUNK_KEYFRAME) != 0;
+    if (!keyframe && !hasReference) return false;
+
+    const uint8_t *p = static_cast<const uint8_t *>(chunk) + sizeof(header);
+    const uint8_t *end = p + header.payloadBytes;
+    const size_t n = bodyCount;
+    out.resize(n);
+
+    if (header.flags & SNAPSHOT_CHUNK_RAW) {
+        // Mirrors SnapshotEncoder::encodeRaw: no reference is kept
+        hasReference = false;
+        if (header.payloadBytes < n * sizeof(float) * SNAPSHOT_FIELD_COUNT) return false;
+        for (std::vector<float> *column : {&out.px, &out.py, &out.pz, &out.vx, &out.vy, &out.vz, &out.mass}) {
+            std::memcpy(column->data(), p, n * sizeof(float));
+            p += n * sizeof(float);
+        }
+        return true;
+    }
+
+    // Any failure past this point leaves the reference half-updated.
+    hasReference = false;
+
+    std::vector<float> *fields[6] = {&out.px, &out.py, &out.pz, &out.vx, &out.vy, &out.vz};
+    for (int group = 0; group < 2; ++group) {
+        if (!decodeStream(p, end, 3 * n, residuals)) return false;
+        double step = group == 0 ? positionStep : velocityStep;
+
+        const uint64_t *r = residuals.data();
+        for (int c = group * 3; c < group * 3 + 3; ++c) {
+            int32_t *ref = previous[c].data();
+            float *dst = fields[c]->data();
+            int64_t t = 0;
+            if (keyframe) {
+                for (size_t i = 0; i < n; ++i) {
+                    t += unzigzag(*r++);
+                    ref[i] = static_cast<int32_t>(t);
+                    dst[i] = static_cast<float>(static_cast<double>(t) * step);
+                }
+            } else {
+                const uint32_t *ord = order.data();
+                for (size_t k = 0; k < n; ++k) {
+                    t += unzigzag(*r++);
+                    int64_t q = t + ref[k];
+                    ref[k] = static_cast<int32_t>(q);
+                    dst[ord[k]] = static_cast<float>(static_cast<double>(q) * step);
+                }
+            }
+        }
+    }
+
+    if (!decodeStream(p, end, n, residuals)) return false;
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t bits = static_cast<uint32_t>(residuals[i]);
+        if (!keyframe) bits ^= previousMass[i];
+        previousMass[i] = bits;
+        std::memcpy(&out.mass[i], &bits, sizeof(bits));
+    }
+
+    if (keyframe) updateOrder();
+    hasReference = true;
+    return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Snapshot.h"
+
+// Quantized delta encoding for snapshot chunks (SnapshotEncoding::QuantizedDelta).
+//
+// Positions and velocities are rounded to a grid of 2 * error, so the
+// reconstruction is within `error` of the original. Each value is then
+// predicted from the previous chunk (keyframes predict from zero) and the
+// temporal residuals are differenced again between neighbours in Morton
+// order of the last keyframe, so bodies that move together cost almost
+// nothing. Masses are stored as the XOR of their float bits with the
+// previous chunk, which is lossless.
+//
+// Residuals are zigzag mapped and split into a bit-length symbol, coded with
+// a static rANS model stored per stream, and the remaining low bits, packed
+// raw. Payload of a quantized chunk:
+//
+//   stream positions   (3N residuals: x block, y block, z block)
+//   stream velocities  (3N residuals)
+//   stream masses      (N XOR words)
+//
+// with each stream laid out as
+//
+//   uint16 freq[RESIDUAL_SYMBOLS]
+//   uint64 ransBytes,  rANS bytes
+//   uint64 extraBytes, packed extra bits
+//
+// A step with a value that does not fit the int32 grid (or is not finite)
+// is written as a raw chunk instead, flagged SNAPSHOT_CHUNK_RAW, and the
+// next chunk is a keyframe.
+//
+// Encoder and decoder must see the same sequence of chunks from the last
+// keyframe on; the decoder rejects a delta chunk it has no reference for.
+
+class SnapshotCodecState {
+protected:
+    explicit SnapshotCodecState(const SnapshotEncodingOptions &options);
+
+    void resize(size_t n);
+    void updateOrder();
+
+    SnapshotEncodingOptions options;
+    double positionStep, velocityStep;  // quantization grid spacing
+
+    // Quantized values of the previous chunk, one column per component,
+    // stored in `order` so delta chunks walk them sequentially.
+    std::vector<int32_t> previous[6];
+    std::vector<uint32_t> previousMass; // body order
+    std::vector<uint32_t> order;        // Morton order of the last keyframe
+    bool hasReference = false;
+};
+
+class SnapshotEncoder : public SnapshotCodecState {
+public:
+    explicit SnapshotEncoder(const SnapshotEncodingOptions &options);
+
+    // Encodes one step as a complete chunk (header included) into `out`.
+    void encode(uint64_t step, double time, const BodyColumnsView &columns, std::vector<uint8_t> &out);
+
+private:
+    void encodeRaw(uint64_t step, double time, const BodyColumnsView &columns, std::vector<uint8_t> &out);
+
+    uint64_t chunkCount = 0;
+    bool warnedRange = false;
+    std::vector<uint64_t> residuals;
+    std::vector<int32_t> quantized[6];
+};
+
+class SnapshotDecoder : public SnapshotCodecState {
+public:
+    SnapshotDecoder(const SnapshotEncodingOptions &options, size_t bodyCount);
+
+    // Decodes a complete chunk (header included). Returns false for corrupt
+    // input or a delta chunk without the preceding chunks decoded.
+    bool decode(const void *chunk, size_t bytes, BodyColumns &out);
+
+    // Forget the reference so the next decode must start at a keyframe.
+    void reset() { hasReference = false; }
+
+private:
+    size_t bodyCount;
+    std::vector<uint64_t> residuals;
+};
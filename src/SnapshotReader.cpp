@@ -0,0 +1,210 @@
+#include "SnapshotReader.h"
+#include "SnapshotCodec.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+SnapshotReader::SnapshotReader() = default;
+
+SnapshotReader::~SnapshotReader() {
+    close();
+}
+
+bool SnapshotReader::open(const std::string &path) {
+    close();
+
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Could not open snapshot file " << path << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotFileHeader)) {
+        std::cerr << "Snapshot file " << path << " is truncated\n";
+        close();
+        return false;
+    }
+    size = static_cast<size_t>(st.st_size);
+
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Could not map snapshot file " << path << ": " << std::strerror(errno) << "\n";
+        close();
+        return false;
+    }
+    data = static_cast<const uint8_t *>(mapped);
+
+    std::memcpy(&fileHeader, data, sizeof(fileHeader));
+    if (std::memcmp(fileHeader.magic, SNAPSHOT_MAGIC, sizeof(fileHeader.magic)) != 0
+        || fileHeader.version != SNAPSHOT_VERSION
+        || fileHeader.fieldCount != SNAPSHOT_FIELD_COUNT) {
+        std::cerr << path << " is not a version " << SNAPSHOT_VERSION << " snapshot file\n";
+        close();
+        return false;
+    }
+
+    // A quantized file needs positive, finite error bounds, or the
+    // decoder's grid is meaningless.
+    const bool raw = fileHeader.encoding == static_cast<uint32_t>(SnapshotEncoding::Raw);
+    const bool quantized = fileHeader.encoding == static_cast<uint32_t>(SnapshotEncoding::QuantizedDelta)
+                           && fileHeader.positionError > 0.0f && std::isfinite(fileHeader.positionError)
+                           && fileHeader.velocityError > 0.0f && std::isfinite(fileHeader.velocityError)
+                           && fileHeader.keyframeInterval > 0;
+    if (!raw && !quantized) {
+        std::cerr << "Snapshot file " << path << " has an unknown or invalid encoding\n";
+        close();
+        return false;
+    }
+
+    const size_t n = fileHeader.bodyCount;
+    attributesOffset = sizeof(fileHeader);
+    uint64_t chunksOffset = attributesOffset + n * (4 * sizeof(float) + sizeof(uint32_t));
+    if (chunksOffset > size) {
+        std::cerr << "Snapshot file " << path << " is truncated\n";
+        close();
+        return false;
+    }
+
+    // Trust the footer only if it describes exactly the tail of the file.
+    SnapshotFileFooter footer{};
+    bool indexed = false;
+    if (size >= chunksOffset + sizeof(footer)) {
+        std::memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+        const uint64_t tail = size - sizeof(footer);
+        indexed = std::memcmp(footer.magic, SNAPSHOT_MAGIC, sizeof(footer.magic)) == 0
+                  && footer.indexOffset >= chunksOffset && footer.indexOffset <= tail
+                  && footer.chunkCount == (tail - footer.indexOffset) / sizeof(SnapshotIndexEntry)
+                  && footer.indexOffset + footer.chunkCount * sizeof(SnapshotIndexEntry) == tail;
+    }
+    if (indexed) {
+        index.resize(footer.chunkCount);
+        std::memcpy(index.data(), data + footer.indexOffset, index.size() * sizeof(SnapshotIndexEntry));
+        // Every chunk must lie between the attributes and the index
+        for (const SnapshotIndexEntry &entry : index) {
+            if (entry.offset < chunksOffset || entry.offset > footer.indexOffset
+                || entry.bytes < sizeof(SnapshotChunkHeader) || entry.bytes > footer.indexOffset - entry.offset) {
+                std::cerr << "Snapshot file " << path << " has a corrupt index\n";
+                indexed = false;
+                break;
+            }
+        }
+    }
+    if (!indexed) {
+        index.clear();
+        scanChunks(chunksOffset);
+    }
+
+    if (fileHeader.encoding == static_cast<uint32_t>(SnapshotEncoding::QuantizedDelta)) {
+        SnapshotEncodingOptions options;
+        options.positionError = fileHeader.positionError;
+        options.velocityError = fileHeader.velocityError;
+        options.keyframeInterval = fileHeader.keyframeInterval;
+        decoder = std::make_unique<SnapshotDecoder>(options, n);
+    }
+    return true;
+}
+
+void SnapshotReader::close() {
+    if (data) munmap(const_cast<uint8_t *>(data), size);
+    if (fd >= 0) ::close(fd);
+    data = nullptr;
+    fd = -1;
+    size = 0;
+    index.clear();
+    decoder.reset();
+    lastDecoded = SIZE_MAX;
+}
+
+void SnapshotReader::scanChunks(uint64_t offset) {
+    SnapshotChunkHeader header{};
+    while (offset + sizeof(header) <= size) {
+        std::memcpy(&header, data + offset, sizeof(header));
+        if (header.magic != SNAPSHOT_CHUNK_MAGIC || header.payloadBytes > size - offset - sizeof(header)) break;
+        uint64_t bytes = sizeof(header) + header.payloadBytes;
+        index.push_back({header.step, header.time, offset, bytes});
+        offset += bytes;
+    }
+    std::cerr << "Snapshot file has no index, recovered " << index.size() << " chunks\n";
+}
+
+void SnapshotReader::attributes(BodyAttributes &out) const {
+    const size_t n = fileHeader.bodyCount;
+    const uint8_t *p = data + attributesOffset;
+    for (std::vector<float> *column : {&out.radius, &out.colorR, &out.colorG, &out.colorB}) {
+        column->resize(n);
+        std::memcpy(column->data(), p, n * sizeof(float));
+        p += n * sizeof(float);
+    }
+    out.bodyType.resize(n);
+    std::memcpy(out.bodyType.data(), p, n * sizeof(uint32_t));
+}
+
+size_t SnapshotReader::chunkForStep(uint64_t step) const {
+    if (index.empty() || step <= index.front().step) return 0;
+    uint64_t i = (step - index.front().step) / std::max<uint32_t>(fileHeader.stepStride, 1);
+    i = std::min<uint64_t>(i, index.size() - 1);
+    // Off-stride chunks (e.g. a final partial step) just need a short walk.
+    while (i > 0 && index[i].step > step) --i;
+    while (i + 1 < index.size() && index[i + 1].step <= step) ++i;
+    return static_cast<size_t>(i);
+}
+
+size_t SnapshotReader::chunkForTime(double time) const {
+    if (index.size() < 2 || time <= index.front().time) return 0;
+    const double t0 = index.front().time;
+    const double t1 = index.back().time;
+    if (time >= t1) return index.size() - 1;
+
+    size_t i = static_cast<size_t>((time - t0) / (t1 - t0) * static_cast<double>(index.size() - 1));
+    i = std::min(i, index.size() - 1);
+    while (i > 0 && index[i].time > time) --i;
+    while (i + 1 < index.size() && index[i + 1].time <= time) ++i;
+    return i;
+}
+
+bool SnapshotReader::isKeyframe(size_t i) const {
+    SnapshotChunkHeader header;
+    std::memcpy(&header, data + index[i].offset, sizeof(header));
+    return (header.flags & SNAPSHOT_CHUNK_KEYFRAME) != 0;
+}
+
+bool SnapshotReader::decodeChunk(size_t i, BodyColumns &out) {
+    const SnapshotIndexEntry &entry = index[i];
+    if (!decoder) {
+        const size_t n = fileHeader.bodyCount;
+        if (entry.bytes < sizeof(SnapshotChunkHeader) + n * sizeof(float) * SNAPSHOT_FIELD_COUNT) return false;
+        out.resize(n);
+        const uint8_t *p = data + entry.offset + sizeof(SnapshotChunkHeader);
+        for (std::vector<float> *column : {&out.px, &out.py, &out.pz, &out.vx, &out.vy, &out.vz, &out.mass}) {
+            std::memcpy(column->data(), p, n * sizeof(float));
+            p += n * sizeof(float);
+        }
+        return true;
+    }
+    return decoder->decode(data + entry.offset, entry.bytes, out);
+}
+
+bool SnapshotReader::read(size_t i, BodyColumns &out) {
+    if (i >= index.size()) return false;
+    if (!decoder) return decodeChunk(i, out);
+
+    size_t first = i;
+    if (lastDecoded == SIZE_MAX || i != lastDecoded + 1) {
+        while (first > 0 && !isKeyframe(first)) --first;
+        decoder->reset();
+    }
+    for (size_t k = first; k <= i; ++k) {
+        if (!decodeChunk(k, out)) {
+            lastDecoded = SIZE_MAX;
+            return false;
+        }
+    }
+    lastDecoded = i;
+    return true;
+}
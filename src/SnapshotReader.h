@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Snapshot.h"
+
+class SnapshotDecoder;
+
+// Read-only access to a trajectory file through mmap. The chunk index comes
+// from the footer, or from walking the chunk headers when the writer never
+// got to close the file.
+class SnapshotReader {
+public:
+    SnapshotReader();
+    ~SnapshotReader();
+
+    SnapshotReader(const SnapshotReader &) = delete;
+    SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+    const SnapshotFileHeader &header() const { return fileHeader; }
+    uint32_t bodyCount() const { return fileHeader.bodyCount; }
+    void attributes(BodyAttributes &out) const;
+
+    size_t chunkCount() const { return index.size(); }
+    const SnapshotIndexEntry &chunk(size_t i) const { return index[i]; }
+
+    // Chunk holding `step`, or the last one before it. Chunks sit every
+    // stepStride steps, so this is a direct lookup.
+    size_t chunkForStep(uint64_t step) const;
+
+    // Last chunk at or before `time`. Guesses from the average spacing and
+    // walks from there, which is O(1) unless the step size varied wildly.
+    size_t chunkForTime(double time) const;
+
+    // Decodes chunk i. Quantized files restart from the preceding keyframe
+    // unless i directly follows the previously read chunk.
+    bool read(size_t i, BodyColumns &out);
+
+private:
+    bool isKeyframe(size_t i) const;
+    bool decodeChunk(size_t i, BodyColumns &out);
+    void scanChunks(uint64_t offset);
+
+    int fd = -1;
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+    SnapshotFileHeader fileHeader{};
+    uint64_t attributesOffset = 0;
+    std::vector<SnapshotIndexEntry> index;
+
+    std::unique_ptr<SnapshotDecoder> decoder; // quantized files only
+    size_t lastDecoded = SIZE_MAX;
+};
@@ -0,0 +1,46 @@
+#include "SphereMesh.h"
+#include <cmath>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+const SphereMesh &SphereMesh::get(int segments, int rings) {
+    static std::map<std::pair<int, int>, std::unique_ptr<SphereMesh>> cache;
+    auto &mesh = cache[{segments, rings}];
+    if (!mesh) mesh.reset(new SphereMesh(segments, rings));
+    return *mesh;
+}
+
+SphereMesh::SphereMesh(int segments, int rings) {
+    std::vector<float> vertices;
+    vertices.reserve(static_cast<size_t>(rings + 1) * (segments + 1) * 3);
+    for (int i = 0; i <= rings; i++) {
+        float theta = (float)i / (float)rings * (float)M_PI;
+        for (int j = 0; j <= segments; j++) {
+            float phi = (float)j / (float)segments * 2.0f * (float)M_PI;
+
+            vertices.push_back(std::sin(theta) * std::cos(phi));
+            vertices.push_back(std::cos(theta));
+            vertices.push_back(std::sin(theta) * std::sin(phi));
+        }
+    }
+    count = (int)(vertices.size() / 3);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+}
+
+void SphereMesh::draw() const {
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_POINTS, 0, count);
+}
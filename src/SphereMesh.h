@@ -0,0 +1,25 @@
+#pragma once
+#include <glad/glad.h>
+
+// Unit sphere sampled on a latitude/longitude lattice, positions only.
+// Bodies of every size and color share one mesh per tessellation: the
+// model matrix that scales it and the color both come from the per-instance
+// attributes (BodyInstance in BodyRenderer.h).
+class SphereMesh {
+public:
+    // Builds the mesh the first time a tessellation is asked for; needs a
+    // current GL context.
+    static const SphereMesh &get(int segments, int rings);
+
+    void draw() const;
+
+    GLuint vao() const { return VAO; }
+    GLuint vbo() const { return VBO; }
+    int vertexCount() const { return count; }
+
+private:
+    SphereMesh(int segments, int rings);
+
+    GLuint VAO = 0, VBO = 0;
+    int count = 0;
+};
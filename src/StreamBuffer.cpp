@@ -0,0 +1,103 @@
+#include "StreamBuffer.h"
+#include <iostream>
+
+namespace {
+// Nanoseconds per wait before checking again; the wait itself is unbounded.
+constexpr GLuint64 FENCE_WAIT_NS = 1000000;
+}
+
+StreamBuffer::~StreamBuffer() {
+    release();
+}
+
+void StreamBuffer::release() {
+    for (GLsync &f : fences) {
+        if (f) glDeleteSync(f);
+        f = nullptr;
+    }
+    if (persistent) {
+        glBindBuffer(target, buffer);
+        glUnmapBuffer(target);
+        persistent = nullptr;
+    }
+    if (buffer) glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void StreamBuffer::create(GLenum newTarget, size_t regionBytes) {
+    release();
+    target = newTarget;
+    regionSize = regionBytes;
+    region = 0;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+
+    if (glBufferStorage && glFenceSync) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, regionSize * REGIONS, nullptr, flags);
+        persistent = static_cast<char *>(glMapBufferRange(target, 0, regionSize * REGIONS, flags));
+        if (persistent) {
+            mode = Mode::Persistent;
+            return;
+        }
+        // Storage is immutable now, so start over with a mutable buffer
+        glDeleteBuffers(1, &buffer);
+        glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+    }
+
+    if (glFenceSync) {
+        mode = Mode::Unsynchronized;
+        glBufferData(target, regionSize * REGIONS, nullptr, GL_STREAM_DRAW);
+    } else {
+        mode = Mode::Orphan;
+        glBufferData(target, regionSize, nullptr, GL_STREAM_DRAW);
+    }
+}
+
+void *StreamBuffer::begin() {
+    if (mode != Mode::Orphan) {
+        region = (region + 1) % REGIONS;
+        waitFor(region);
+    }
+
+    glBindBuffer(target, buffer);
+    switch (mode) {
+        case Mode::Persistent:
+            return persistent + offset();
+        case Mode::Unsynchronized:
+            // The fence already proved the GPU is done with this region.
+            return glMapBufferRange(target, offset(), regionSize,
+                                    GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        case Mode::Orphan:
+        default:
+            glBufferData(target, regionSize, nullptr, GL_STREAM_DRAW);
+            return glMapBufferRange(target, 0, regionSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    }
+}
+
+size_t StreamBuffer::end() {
+    if (mode != Mode::Persistent) {
+        glBindBuffer(target, buffer);
+        if (glUnmapBuffer(target) == GL_FALSE) std::cerr << "Stream buffer contents were lost\n";
+    }
+    return offset();
+}
+
+void StreamBuffer::fence() {
+    if (mode == Mode::Orphan) return;
+    // Only the latest draw from this region matters
+    if (fences[region]) glDeleteSync(fences[region]);
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::waitFor(int index) {
+    GLsync f = fences[index];
+    if (!f) return;
+    GLenum status = glClientWaitSync(f, 0, 0);
+    while (status == GL_TIMEOUT_EXPIRED)
+        status = glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_NS);
+    glDeleteSync(f);
+    fences[index] = nullptr;
+}
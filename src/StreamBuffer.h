@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <glad/glad.h>
+
+// GL buffer for data that is rewritten every frame (grid heights, per-body
+// instances). It is split into REGIONS regions used round-robin, each
+// guarded by a fence, so the CPU fills one region while the GPU may still be
+// reading the others and neither waits on the other.
+//
+// On a GL 4.4 context (the bundled glad loads glBufferStorage only as core
+// 4.4, not through the ARB extension) the buffer is mapped once, persistent
+// and coherent, and writes land directly in it. On older contexts each
+// region is mapped unsynchronized for the write instead. Without fence support the
+// buffer is orphaned on every write.
+class StreamBuffer {
+public:
+    static constexpr int REGIONS = 3;
+
+    StreamBuffer() = default;
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+    // Allocates the regions on `target`, dropping any previous storage.
+    void create(GLenum target, size_t regionBytes);
+
+    // Moves to the next region and returns where to write up to
+    // regionBytes() of data.
+    void *begin();
+    // Ends the write; returns the byte offset of the region just written,
+    // for attribute pointers and draw offsets.
+    size_t end();
+    // Call after issuing the draws that read the current region.
+    void fence();
+
+    GLuint id() const { return buffer; }
+    size_t regionBytes() const { return regionSize; }
+    size_t offset() const { return region * regionSize; }
+
+private:
+    enum class Mode { Persistent, Unsynchronized, Orphan };
+
+    void release();
+    void waitFor(int index);
+
+    GLenum target = GL_ARRAY_BUFFER;
+    GLuint buffer = 0;
+    Mode mode = Mode::Orphan;
+    size_t regionSize = 0;
+    int region = 0;
+    char *persistent = nullptr;
+    GLsync fences[REGIONS] = {};
+};
@@ -0,0 +1,87 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads) {
+    // The calling thread works too, so spawn one fewer.
+    unsigned spawn = threads > 1 ? threads - 1 : 0;
+    workers.reserve(spawn);
+    for (unsigned i = 0; i < spawn; ++i) workers.emplace_back(&ThreadPool::run, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &t : workers) t.join();
+}
+
+ThreadPool &ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn) {
+    if (count == 0) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || workers.empty()) {
+        fn(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobCount = count;
+        jobGrain = grain;
+        nextChunk = 0;
+        chunkCount = chunks;
+        chunksDone = 0;
+        ++generation;
+    }
+    wake.notify_all();
+
+    while (runChunk()) {}
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return chunksDone == chunkCount; });
+    job = nullptr;
+}
+
+// Claims and runs one chunk of the current job; false when none are left.
+bool ThreadPool::runChunk() {
+    const std::function<void(size_t, size_t)> *fn;
+    size_t begin, end;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!job || nextChunk == chunkCount) return false;
+        fn = job;
+        begin = nextChunk++ * jobGrain;
+        end = std::min(begin + jobGrain, jobCount);
+    }
+
+    (*fn)(begin, end);
+
+    bool last;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        last = ++chunksDone == chunkCount;
+    }
+    if (last) done.notify_all();
+    return true;
+}
+
+void ThreadPool::run() {
+    unsigned seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || (generation != seen && job); });
+            if (stopping) return;
+            seen = generation;
+        }
+        while (runChunk()) {}
+    }
+}
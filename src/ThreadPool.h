@@ -0,0 +1,46 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. parallelFor() splits
+// [0, count) into chunks, runs them on the workers and the calling thread,
+// and returns when all are done. One parallelFor runs at a time; calling it
+// from inside a job or from two threads at once is not supported.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // fn(begin, end) is called on disjoint ranges covering [0, count), each
+    // at most `grain` long.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)> &fn);
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Pool shared by the renderer-side helpers (grid, culling, ...).
+    static ThreadPool &global();
+
+private:
+    void run();
+    bool runChunk();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    bool stopping = false;
+
+    // Current job, guarded by mutex
+    const std::function<void(size_t, size_t)> *job = nullptr;
+    size_t jobCount = 0, jobGrain = 1;
+    size_t nextChunk = 0, chunkCount = 0, chunksDone = 0;
+    unsigned generation = 0;
+};
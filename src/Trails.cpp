@@ -0,0 +1,106 @@
+#include "Trails.h"
+#include <algorithm>
+#include <iostream>
+
+Trails::Trails(int length, float interval)
+    : requestedLength(std::max(2, length)), length(requestedLength), interval(interval) {
+    // Everything comes from the buffer texture, but core profile still
+    // wants a vertex array bound to draw.
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &TBO);
+    glGenTextures(1, &texture);
+}
+
+Trails::~Trails() {
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &TBO);
+    glDeleteVertexArrays(1, &VAO);
+}
+
+bool Trails::due(float time) {
+    if (time < nextSample) return false;
+    nextSample = time + interval;
+    return true;
+}
+
+void Trails::allocate(size_t bodyCount) {
+    bodies = bodyCount;
+    head = -1;
+    filled = 0;
+    fits = false;
+    length = requestedLength;
+    if (bodies == 0) return;
+
+    // The whole ring has to fit in one buffer texture
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    const size_t slotTexels = 3 * bodies;
+    const int fit = static_cast<int>(std::min<size_t>(static_cast<size_t>(maxTexels) / slotTexels, length));
+    if (fit < 2) {
+        std::cerr << "Trails disabled: " << bodies << " bodies do not fit a buffer texture of "
+                  << maxTexels << " texels\n";
+        return;
+    }
+    if (fit < length) {
+        std::cerr << "Trails shortened to " << fit << " samples to fit a buffer texture\n";
+        length = fit;
+    }
+    fits = true;
+
+    glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+    glBufferData(GL_TEXTURE_BUFFER, slotTexels * length * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, TBO);
+}
+
+float *Trails::beginSample(size_t bodyCount) {
+    if (bodyCount != bodies) allocate(bodyCount);
+    staged.resize(3 * bodies);
+    return staged.data();
+}
+
+void Trails::endSample() {
+    if (!fits) return;
+    head = (head + 1) % length;
+    filled = std::min(filled + 1, length);
+
+    // Only the slot being replaced changes
+    const size_t slotBytes = staged.size() * sizeof(float);
+    glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+    glBufferSubData(GL_TEXTURE_BUFFER, head * slotBytes, slotBytes, staged.data());
+}
+
+void Trails::draw(Shader &shader, const glm::dvec3 &eye) {
+    if (filled < 2) return;
+    if (uniformShader != &shader) {
+        positionsUniform = shader.uniform<int>("trailPositions");
+        bodiesUniform = shader.uniform<int>("trailBodies");
+        slotsUniform = shader.uniform<int>("trailSlots");
+        headUniform = shader.uniform<int>("trailHead");
+        filledUniform = shader.uniform<int>("trailFilled");
+        originUniform = shader.uniform<glm::vec3>("trailOrigin");
+        uniformShader = &shader;
+    }
+    shader.set(positionsUniform, 0);
+    shader.set(bodiesUniform, static_cast<int>(bodies));
+    shader.set(slotsUniform, length);
+    shader.set(headUniform, head);
+    shader.set(filledUniform, filled);
+    shader.set(originUniform, glm::vec3(-eye));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glBindVertexArray(VAO);
+
+    // Segment s of a body joins slot s to slot s + 1, so the segments to
+    // draw start at every slot from the oldest up to just before the head.
+    // In slot order that is one range, or two when it runs past the end.
+    const int oldest = filled < length ? 0 : (head + 1) % length;
+    const GLint perSlot = static_cast<GLint>(2 * bodies); // two vertices per body
+    if (oldest < head) {
+        glDrawArrays(GL_LINES, oldest * perSlot, (head - oldest) * perSlot);
+    } else {
+        glDrawArrays(GL_LINES, oldest * perSlot, (length - oldest) * perSlot);
+        if (head > 0) glDrawArrays(GL_LINES, 0, head * perSlot);
+    }
+}
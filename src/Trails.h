@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "Shader.h"
+
+// Orbit trails: the last `length` positions of every body, sampled every
+// `interval` seconds. Samples live in a ring of slots on the GPU, one slot
+// per sample holding the x, y and z of all bodies as three contiguous
+// blocks (x0..xN-1, y0..yN-1, z0..zN-1). Appending a sample uploads only
+// that slot, and the trail shader reads positions from a buffer texture by
+// gl_VertexID, so no vertex data is ever rearranged. The lines are drawn in
+// at most two ranges, split where the ring wraps.
+//
+// Samples are world positions and are drawn through the offset to the
+// camera, taken in double.
+//
+//     if (trails.due(time)) {
+//         float *xyz = trails.beginSample(n);
+//         ... xyz[i] = x_i, xyz[n + i] = y_i, xyz[2n + i] = z_i ...
+//         trails.endSample();
+//     }
+//     trails.draw(trailShader, eye);
+class Trails {
+public:
+    Trails(int length, float interval);
+    ~Trails();
+
+    bool due(float time);
+
+    // Staging for one sample of `bodyCount` bodies. A different count from
+    // the last sample restarts the trails, at the requested length or as
+    // many samples as fit a buffer texture for that count. With more bodies
+    // than two samples' worth, samples are dropped and nothing is drawn.
+    float *beginSample(size_t bodyCount);
+    void endSample();
+
+    // `eye` is the camera's world position.
+    void draw(Shader &shader, const glm::dvec3 &eye);
+
+private:
+    void allocate(size_t bodyCount);
+
+    int requestedLength;
+    int length;     // slots in the ring, at most requestedLength
+    float interval;
+    float nextSample = 0.0f;
+
+    size_t bodies = 0;
+    bool fits = false; // the ring for `bodies` is allocated
+    int head = -1;   // slot of the newest sample
+    int filled = 0;  // slots holding samples
+    std::vector<float> staged;
+
+    GLuint VAO = 0, TBO = 0, texture = 0;
+
+    const Shader *uniformShader = nullptr;
+    Uniform<int> positionsUniform, bodiesUniform, slotsUniform, headUniform, filledUniform;
+    Uniform<glm::vec3> originUniform;
+};
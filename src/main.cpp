@@ -2,19 +2,34 @@
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
 #include <vector>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 
 #include "Camera.h"
+#include "CameraBuffer.h"
 #include "Shader.h"
+#include "ShaderWatcher.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "Planet.h"
+#include "BodyRenderer.h"
+#include "BodyBVH.h"
+#include "Trails.h"
 #include "Grid.h"
+#include "AdaptiveGrid.h"
+#include "AsyncSnapshotWriter.h"
+#include "ReplayPlayer.h"
+#include "Checkpoint.h"
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void processInput(GLFWwindow* window, Camera& camera, float deltaTime);
+void processReplayInput(GLFWwindow* window, ReplayPlayer& replay, float deltaTime);
 
 bool firstMouse = true;
 int width = 800;
@@ -24,6 +39,111 @@ float lastY = height / 2.0f;
 
 const float GLOBAL_G = 0.9f;
 
+// Replay playback state, toggled from key_callback
+bool replayPaused = false;
+const float REPLAY_SCRUB_RATE = 10.0f; // sim seconds per second while scrubbing
+
+struct Options {
+    std::string snapshotPath;      // empty = no trajectory output
+    uint32_t snapshotEvery = 10;   // steps between snapshots
+    SnapshotEncodingOptions snapshotEncoding;
+    std::string replayPath;        // play back a recording instead of simulating
+    float fixedDt = 0.0f;          // > 0: deterministic fixed physics step
+    std::string checkpointPath;    // empty = no checkpoints
+    float checkpointEvery = 300.0f; // wall-clock seconds between checkpoints
+    bool restart = false;          // resume from checkpointPath
+    float gridTheta = 0.5f;        // grid potential accuracy, 0 = exact
+    bool adaptiveGrid = false;     // quadtree grid refined near masses
+    bool impostors = false;        // ray-cast spheres instead of point clouds
+    std::string shaderCache = "shader_cache"; // linked program binaries, empty = off
+    std::string shaderDir;         // load GLSL from here instead of the embedded copies
+    bool trails = false;           // draw orbit trails
+    int trailLength = 256;         // samples kept per body
+    float trailInterval = 0.25f;   // seconds between samples
+};
+
+// Upper bound on fixed steps per frame so a slow frame can't snowball.
+const int MAX_STEPS_PER_FRAME = 8;
+
+// Depth is reversed with no far plane, so the near plane can sit close.
+const float NEAR_PLANE = 0.01f;
+// How far the camera's float offset may grow before it is folded into its
+// double-precision origin.
+const float REBASE_DISTANCE = 1000.0f;
+
+void printUsage(const char *argv0) {
+    std::cerr << "Usage: " << argv0 << " [--snapshot <file>] [--snapshot-every <steps>]"
+              << " [--snapshot-error <abs>] [--snapshot-keyframe <chunks>] [--replay <file>]"
+              << " [--fixed-dt <seconds>] [--checkpoint <file>] [--checkpoint-every <seconds>] [--restart]"
+              << " [--grid-theta <angle>] [--adaptive-grid] [--impostors] [--shader-cache <dir>]"
+              << " [--shader-dir <dir>] [--trails] [--trail-length <samples>] [--trail-interval <seconds>]\n";
+}
+
+// Handles for the uniforms set on a scene shader every frame. Ones a shader
+// does not declare resolve to -1 and are ignored.
+struct SceneUniforms {
+    Uniform<glm::mat4> model;
+    Uniform<glm::vec3> lightPos, gridColor, trailColor;
+
+    explicit SceneUniforms(Shader &shader)
+        : model(shader.uniform<glm::mat4>("model")),
+          lightPos(shader.uniform<glm::vec3>("lightPos")),
+          gridColor(shader.uniform<glm::vec3>("gridColor")),
+          trailColor(shader.uniform<glm::vec3>("trailColor")) {}
+};
+
+bool parseOptions(int argc, char **argv, Options &opts) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "--snapshot") == 0 && hasValue) {
+            opts.snapshotPath = argv[++i];
+        } else if (std::strcmp(arg, "--snapshot-every") == 0 && hasValue) {
+            opts.snapshotEvery = static_cast<uint32_t>(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(arg, "--snapshot-error") == 0 && hasValue) {
+            float error = std::strtof(argv[++i], nullptr);
+            opts.snapshotEncoding.positionError = error;
+            opts.snapshotEncoding.velocityError = error;
+        } else if (std::strcmp(arg, "--snapshot-keyframe") == 0 && hasValue) {
+            opts.snapshotEncoding.keyframeInterval = static_cast<uint32_t>(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(arg, "--replay") == 0 && hasValue) {
+            opts.replayPath = argv[++i];
+        } else if (std::strcmp(arg, "--fixed-dt") == 0 && hasValue) {
+            opts.fixedDt = std::max(0.0f, std::strtof(argv[++i], nullptr));
+        } else if (std::strcmp(arg, "--checkpoint") == 0 && hasValue) {
+            opts.checkpointPath = argv[++i];
+        } else if (std::strcmp(arg, "--checkpoint-every") == 0 && hasValue) {
+            opts.checkpointEvery = std::max(1.0f, std::strtof(argv[++i], nullptr));
+        } else if (std::strcmp(arg, "--restart") == 0) {
+            opts.restart = true;
+        } else if (std::strcmp(arg, "--grid-theta") == 0 && hasValue) {
+            opts.gridTheta = std::max(0.0f, std::strtof(argv[++i], nullptr));
+        } else if (std::strcmp(arg, "--adaptive-grid") == 0) {
+            opts.adaptiveGrid = true;
+        } else if (std::strcmp(arg, "--impostors") == 0) {
+            opts.impostors = true;
+        } else if (std::strcmp(arg, "--shader-cache") == 0 && hasValue) {
+            opts.shaderCache = argv[++i];
+        } else if (std::strcmp(arg, "--shader-dir") == 0 && hasValue) {
+            opts.shaderDir = argv[++i];
+        } else if (std::strcmp(arg, "--trails") == 0) {
+            opts.trails = true;
+        } else if (std::strcmp(arg, "--trail-length") == 0 && hasValue) {
+            opts.trailLength = static_cast<int>(std::max(2L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (std::strcmp(arg, "--trail-interval") == 0 && hasValue) {
+            opts.trailInterval = std::max(0.0f, std::strtof(argv[++i], nullptr));
+        } else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    if (opts.restart && opts.checkpointPath.empty()) {
+        std::cerr << "--restart needs --checkpoint <file>\n";
+        return false;
+    }
+    return true;
+}
+
 // O(N^2) pairwise gravity with small perf tweaks (fewer sqrt/divs)
 void stepNBody(std::vector<Planet>& planets, float deltaTime) {
     const float soft = 0.2f;
@@ -76,7 +196,104 @@ void enforceCenterOfMassFrame(std::vector<Planet>& planets) {
     }
 }
 
-int main(){
+// Copy the AoS planet state into the column layout used by snapshots.
+void gatherBodyColumns(const std::vector<Planet>& planets, BodyColumns& columns) {
+    columns.resize(planets.size());
+    for (size_t i = 0; i < planets.size(); ++i) {
+        const Planet &p = planets[i];
+        columns.px[i] = p.worldPosition.x;
+        columns.py[i] = p.worldPosition.y;
+        columns.pz[i] = p.worldPosition.z;
+        columns.vx[i] = p.velocity.x;
+        columns.vy[i] = p.velocity.y;
+        columns.vz[i] = p.velocity.z;
+        columns.mass[i] = p.mass;
+    }
+}
+
+// Inverse of gatherBodyColumns, used to drive the bodies from a replay.
+void scatterBodyColumns(const BodyColumns& columns, std::vector<Planet>& planets) {
+    for (size_t i = 0; i < planets.size() && i < columns.size(); ++i) {
+        Planet &p = planets[i];
+        p.worldPosition = glm::vec3(columns.px[i], columns.py[i], columns.pz[i]);
+        p.velocity = glm::vec3(columns.vx[i], columns.vy[i], columns.vz[i]);
+        p.mass = columns.mass[i];
+    }
+}
+
+void gatherBodyAttributes(const std::vector<Planet>& planets, BodyAttributes& attributes) {
+    size_t n = planets.size();
+    attributes.radius.resize(n);
+    attributes.colorR.resize(n);
+    attributes.colorG.resize(n);
+    attributes.colorB.resize(n);
+    attributes.bodyType.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        const Planet &p = planets[i];
+        attributes.radius[i] = p.radius;
+        attributes.colorR[i] = p.color.r;
+        attributes.colorG[i] = p.color.g;
+        attributes.colorB[i] = p.color.b;
+        attributes.bodyType[i] = static_cast<uint32_t>(p.isStar() ? BodyType::Star : BodyType::Planetary);
+    }
+}
+
+void captureCheckpoint(const std::vector<Planet>& planets, uint64_t step, double simTime,
+                       double accumulator, float fixedDt, CheckpointState& state) {
+    state.step = step;
+    state.simTime = simTime;
+    state.accumulator = accumulator;
+    state.fixedDt = fixedDt;
+    gatherBodyColumns(planets, state.bodies);
+    gatherBodyAttributes(planets, state.attributes);
+    size_t n = planets.size();
+    state.orbitAngle.resize(n);
+    state.distance.resize(n);
+    state.orbitSpeed.resize(n);
+    state.rotationSpeed.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        state.orbitAngle[i] = planets[i].orbitAngle;
+        state.distance[i] = planets[i].distance;
+        state.orbitSpeed[i] = planets[i].orbitSpeed;
+        state.rotationSpeed[i] = planets[i].rotationSpeed;
+    }
+}
+
+// Rebuild the bodies exactly as they were when the checkpoint was taken.
+void restorePlanets(const CheckpointState& state, std::vector<Planet>& planets) {
+    planets.clear();
+    for (size_t i = 0; i < state.size(); ++i) {
+        const BodyAttributes &a = state.attributes;
+        planets.emplace_back(
+                a.radius[i], state.bodies.mass[i],
+                state.orbitAngle[i], state.distance[i], state.orbitSpeed[i],
+                state.rotationSpeed[i],
+                glm::vec3(a.colorR[i], a.colorG[i], a.colorB[i]),
+                a.bodyType[i] == static_cast<uint32_t>(BodyType::Star) ? BodyType::Star : BodyType::Planetary
+        );
+    }
+    scatterBodyColumns(state.bodies, planets);
+}
+
+// Perspective for GL_ZERO_TO_ONE clip space with depth 1 at the near plane
+// falling towards 0 at infinity. Float depth is densest near 0, so this
+// spreads precision evenly over distance instead of piling it up close in.
+glm::mat4 reversedInfinitePerspective(float fovy, float aspect, float zNear) {
+    const float f = 1.0f / std::tan(fovy / 2.0f);
+    glm::mat4 m(0.0f);
+    m[0][0] = f / aspect;
+    m[1][1] = f;
+    m[2][3] = -1.0f;
+    m[3][2] = zNear;
+    return m;
+}
+
+int runSimulation(GLFWwindow *window, Options &opts);
+
+int main(int argc, char **argv){
+    Options opts;
+    if (!parseOptions(argc, argv, opts)) return -1;
+
     if(!glfwInit()){
         std::cerr << "Failed to initialize program\n";
         return -1;
@@ -106,10 +323,42 @@ int main(){
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetKeyCallback(window, key_callback);
+
+    // Everything that owns GL objects lives in runSimulation, so it is all
+    // destroyed while the context still exists
+    int status = runSimulation(window, opts);
+    glfwTerminate();
+    return status;
+}
 
+int runSimulation(GLFWwindow *window, Options &opts) {
     // Shaders
-    Shader planetShader("shaders/pvShader.glsl", "shaders/pfShader.glsl");
-    Shader gridShader("shaders/gridvert.glsl", "shaders/gridfrag.glsl");
+    setProgramCacheDirectory(opts.shaderCache);
+    setShaderDirectory(opts.shaderDir);
+    Shader planetShader("pvShader.glsl", "pfShader.glsl");
+    Shader impostorShader("impostorvert.glsl", "impostorfrag.glsl");
+    Shader gridShader("gridvert.glsl", "gridfrag.glsl");
+    Shader adaptiveGridShader("adaptivegridvert.glsl", "gridfrag.glsl");
+    Shader trailShader("trailvert.glsl", "trailfrag.glsl");
+    // View and projection reach every shader through the Camera block
+    CameraBuffer cameraBuffer;
+    for (Shader *shader : {&planetShader, &impostorShader, &gridShader, &adaptiveGridShader, &trailShader}) {
+        shader->bindBlock("Camera", CameraBuffer::BINDING);
+    }
+    // Shaders loaded from disk are relinked when their files change
+    ShaderWatcher shaderWatcher;
+    if (!opts.shaderDir.empty()) {
+        for (Shader *shader : {&planetShader, &impostorShader, &gridShader, &adaptiveGridShader, &trailShader}) {
+            shaderWatcher.watch(*shader);
+        }
+        shaderWatcher.start(opts.shaderDir);
+    }
+    SceneUniforms planetUniforms(planetShader);
+    SceneUniforms impostorUniforms(impostorShader);
+    SceneUniforms gridUniforms(gridShader);
+    SceneUniforms adaptiveGridUniforms(adaptiveGridShader);
+    SceneUniforms trailUniforms(trailShader);
 
     // Camera
     Camera camera(
@@ -120,7 +369,20 @@ int main(){
     );
     glfwSetWindowUserPointer(window, &camera);
 
+    BodyRenderer bodyRenderer(128, 128);
+    bodyRenderer.setImpostors(opts.impostors);
+    BodyBVH bodyBVH;
+    std::vector<glm::vec4> bodySpheres;
+    std::vector<uint32_t> visibleBodies;
+
+    Trails trails(opts.trailLength, opts.trailInterval);
+
     Grid grid(50, 0.4f);
+    grid.setOpeningAngle(opts.gridTheta);
+
+    // Same 20x20 footprint, cells from 2.5 down to ~0.16
+    AdaptiveGrid adaptiveGrid(20.0f, 3, 7, 0.02f);
+    adaptiveGrid.setOpeningAngle(opts.gridTheta);
 
     std::vector<Planet> planets;
 
@@ -164,9 +426,85 @@ int main(){
 
     enforceCenterOfMassFrame(planets);
 
+    uint64_t step = 0;
+    double simTime = 0.0;
+    double accumulator = 0.0;
+
+    // Resume a previous run
+    if (opts.restart) {
+        CheckpointState state;
+        if (!loadCheckpoint(opts.checkpointPath, state)) {
+            return -1;
+        }
+        restorePlanets(state, planets);
+        step = state.step;
+        simTime = state.simTime;
+        accumulator = state.accumulator;
+        if (state.fixedDt > 0.0f) opts.fixedDt = state.fixedDt;
+        std::cout << "Resumed from " << opts.checkpointPath << " at step " << step << "\n";
+    }
+
+    // Replay replaces the scene with the recorded bodies
+    ReplayPlayer replay;
+    if (!opts.replayPath.empty()) {
+        if (!replay.open(opts.replayPath)) {
+            return -1;
+        }
+        const BodyAttributes &attributes = replay.attributes();
+        planets.clear();
+        for (size_t i = 0; i < attributes.size(); ++i) {
+            planets.emplace_back(
+                    attributes.radius[i], 0.0f,
+                    0.0f, 0.0f, 0.0f,
+                    0.3f,
+                    glm::vec3(attributes.colorR[i], attributes.colorG[i], attributes.colorB[i]),
+                    attributes.bodyType[i] == static_cast<uint32_t>(BodyType::Star) ? BodyType::Star
+                                                                                    : BodyType::Planetary
+            );
+        }
+        scatterBodyColumns(replay.frame(), planets);
+    }
+
+    // Trajectory output
+    BodyColumns columns;
+    AsyncSnapshotWriter snapshots;
+    if (!opts.snapshotPath.empty() && !replay.isOpen()) {
+        BodyAttributes attributes;
+        gatherBodyAttributes(planets, attributes);
+        // A restarted run continues its trajectory rather than truncating it
+        bool opened = opts.restart
+                      ? snapshots.resume(opts.snapshotPath, attributes, opts.snapshotEvery,
+                                         opts.snapshotEncoding, step)
+                      : snapshots.open(opts.snapshotPath, attributes, opts.snapshotEvery, opts.snapshotEncoding);
+        if (opened) {
+            gatherBodyColumns(planets, columns);
+            snapshots.submit(step, simTime, columns);
+        }
+    }
+
+    CheckpointWriter checkpoints;
+    double lastCheckpoint = 0.0;
+    bool checkpointing = !opts.checkpointPath.empty() && !replay.isOpen();
+
     float deltaTime = 0.0f;
     float lastFrame = 0.0f;
 
+    // The window is fixed size, so the projection never changes. With
+    // glClipControl depth is reversed; otherwise it runs the usual way, but
+    // either way there is no far plane to clip a large scene.
+    const float aspect = static_cast<float>(width)/height;
+    const bool reversedZ = glClipControl != nullptr;
+    glm::mat4 projection;
+    if (reversedZ) {
+        glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+        glClearDepth(0.0);
+        glDepthFunc(GL_GREATER);
+        projection = reversedInfinitePerspective(glm::radians(45.0f), aspect, NEAR_PLANE);
+    } else {
+        projection = glm::infinitePerspective(glm::radians(45.0f), aspect, NEAR_PLANE);
+    }
+    cameraBuffer.setDepthZeroToOne(reversedZ);
+
     while(!glfwWindowShouldClose(window)){
         glClearColor(0.0f, 0.0f, 0.0f,1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -178,57 +516,139 @@ int main(){
         lastFrame = currentFrame;
 
         processInput(window, camera, deltaTime);
+        shaderWatcher.apply();
+
+        if (replay.isOpen()) {
+            // Playback: no physics, just sample the recording
+            processReplayInput(window, replay, deltaTime);
+            scatterBodyColumns(replay.frame(), planets);
+        } else {
+            // Physics: one step of the frame time, or whole fixed steps so
+            // the trajectory doesn't depend on the frame rate
+            int steps = 1;
+            float dt = deltaTime;
+            if (opts.fixedDt > 0.0f) {
+                accumulator += deltaTime;
+                steps = std::min(static_cast<int>(accumulator / opts.fixedDt), MAX_STEPS_PER_FRAME);
+                accumulator = std::min(accumulator - steps * static_cast<double>(opts.fixedDt),
+                                       static_cast<double>(opts.fixedDt));
+                dt = opts.fixedDt;
+            }
+
+            for (int s = 0; s < steps; ++s) {
+                stepNBody(planets, dt);
+                enforceCenterOfMassFrame(planets);
+                ++step;
+                simTime += dt;
+
+                if (snapshots.due(step)) {
+                    gatherBodyColumns(planets, columns);
+                    snapshots.submit(step, simTime, columns);
+                }
+            }
+
+            if (checkpointing && currentFrame - lastCheckpoint >= opts.checkpointEvery) {
+                CheckpointState state;
+                captureCheckpoint(planets, step, simTime, accumulator, opts.fixedDt, state);
+                if (checkpoints.saveAsync(opts.checkpointPath, std::move(state))) lastCheckpoint = currentFrame;
+            }
+        }
 
-        // Physics
-        stepNBody(planets, deltaTime);
-        enforceCenterOfMassFrame(planets);
-
-        glm::mat4 view = camera.getViewMatrix();
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f),
-                                                static_cast<float>(width)/height,
-                                                0.1f, 100.0f);
+        if (opts.trails && trails.due(currentFrame)) {
+            const size_t n = planets.size();
+            float *xyz = trails.beginSample(n);
+            for (size_t i = 0; i < n; ++i) {
+                xyz[i] = planets[i].worldPosition.x;
+                xyz[n + i] = planets[i].worldPosition.y;
+                xyz[2 * n + i] = planets[i].worldPosition.z;
+            }
+            trails.endSample();
+        }
 
-        for (auto &p : planets) {
-            p.update(currentFrame);
+        // Everything is drawn relative to the camera, whose world position
+        // is held in double, so the view matrix holds only the rotation.
+        // The physics frame never moves; only the camera is rebased.
+        camera.rebase(REBASE_DISTANCE);
+        const glm::dvec3 eye = camera.worldPosition();
+        glm::mat4 view = camera.getRotationMatrix();
+        cameraBuffer.update(view, projection);
+
+        // Sprite diameter in pixels for the point-cloud path, purely visual
+        auto pointSize = [sunRadius](const Planet &p) {
+            return (p.isStar() ? 80.0f : 28.0f) * p.radius / sunRadius;
+        };
+
+        // Only bodies whose bounding sphere reaches the frustum are drawn.
+        // Point sprites stick out of the sphere by half their size in
+        // pixels; distance stands in for depth, which only pads more.
+        const float pixelsPerUnit = projection[1][1] * 0.5f * static_cast<float>(height);
+        bodySpheres.resize(planets.size());
+        for (size_t i = 0; i < planets.size(); ++i) {
+            glm::vec3 center(glm::dvec3(planets[i].worldPosition) - eye);
+            float radius = planets[i].radius;
+            if (!opts.impostors) radius += 0.5f * pointSize(planets[i]) * glm::length(center) / pixelsPerUnit;
+            bodySpheres[i] = glm::vec4(center, radius);
         }
+        bodyBVH.update(bodySpheres);
+        bodyBVH.cull(bodySpheres, projection * view, visibleBodies);
+        for (uint32_t i : visibleBodies) planets[i].update(currentFrame, eye);
 
         // Grid sources from all planets
         std::vector<Grid::GravitySource> sources;
         sources.reserve(planets.size());
         for (auto &p : planets) sources.push_back({ p.worldPosition, p.mass });
-        grid.update(sources);
-
-        // Draw planets
-        planetShader.use();
-        planetShader.setMat4("projection", projection);
-        planetShader.setMat4("view", view);
+        if (opts.adaptiveGrid) adaptiveGrid.update(sources);
+        else grid.update(sources);
+
+        // Draw planets, one instanced call per level of detail
+        Shader &bodyShader = opts.impostors ? impostorShader : planetShader;
+        const SceneUniforms &bodyUniforms = opts.impostors ? impostorUniforms : planetUniforms;
+        bodyShader.use();
+        if (opts.impostors) {
+            auto star = std::find_if(planets.begin(), planets.end(), [](const Planet &p) { return p.isStar(); });
+            glm::vec3 light(star != planets.end() ? glm::dvec3(star->worldPosition) - eye : -eye);
+            bodyShader.set(bodyUniforms.lightPos, glm::vec3(view * glm::vec4(light, 1.0f)));
+        }
 
-        for (auto &p : planets) {
+        BodyInstance *instances = bodyRenderer.beginFrame(visibleBodies, planets.size());
+        for (size_t i = 0; i < visibleBodies.size(); ++i) {
+            const Planet &p = planets[visibleBodies[i]];
             bool isSun = p.isStar();
-            glm::vec3 color = isSun ? glm::vec3(1.0f, 0.9f, 0.6f) : p.color;
-            planetShader.setVec3("baseColor", color);
-            planetShader.setFloat("isSun", isSun ? 1.0f : 0.0f);
-
-            float baseSize = isSun ? 80.0f : 28.0f; // purely visual
-            float pointSize = baseSize * p.radius / sunRadius;
-            planetShader.setFloat("pointSize", pointSize);
 
-            p.draw(planetShader);
+            BodyInstance &instance = instances[i];
+            instance.model = p.model;
+            instance.color = isSun ? glm::vec3(1.0f, 0.9f, 0.6f) : p.color;
+            instance.pointSize = pointSize(p);
+            instance.isSun = isSun ? 1.0f : 0.0f;
         }
+        bodyRenderer.draw(view, projection, static_cast<float>(height));
 
         // Draw grid
-        gridShader.use();
-        gridShader.setMat4("projection", projection);
-        gridShader.setMat4("view", view);
-        gridShader.setMat4("model", glm::mat4(1.0f));
-        gridShader.setVec3("gridColor", glm::vec3(0.8f, 0.8f, 0.8f));
-        grid.draw(gridShader);
+        Shader &activeGridShader = opts.adaptiveGrid ? adaptiveGridShader : gridShader;
+        const SceneUniforms &activeGridUniforms = opts.adaptiveGrid ? adaptiveGridUniforms : gridUniforms;
+        activeGridShader.use();
+        activeGridShader.set(activeGridUniforms.model, glm::mat4(1.0f));
+        activeGridShader.set(activeGridUniforms.gridColor, glm::vec3(0.8f, 0.8f, 0.8f));
+        if (opts.adaptiveGrid) adaptiveGrid.draw(activeGridShader, eye);
+        else grid.draw(activeGridShader, eye);
+
+        if (opts.trails) {
+            trailShader.use();
+            trailShader.set(trailUniforms.trailColor, glm::vec3(0.6f, 0.7f, 1.0f));
+            trails.draw(trailShader, eye);
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
-    glfwTerminate();
+    if (checkpointing) {
+        checkpoints.wait();
+        CheckpointState state;
+        captureCheckpoint(planets, step, simTime, accumulator, opts.fixedDt, state);
+        saveCheckpoint(opts.checkpointPath, state);
+    }
+    snapshots.close();
     return 0;
 }
 
@@ -244,6 +664,20 @@ void processInput(GLFWwindow* window, Camera& camera, float deltaTime) {
     if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) camera.processKeyboard(LOOKRIGHT, deltaTime);
 }
 
+void processReplayInput(GLFWwindow* window, ReplayPlayer& replay, float deltaTime) {
+    if (glfwGetKey(window, GLFW_KEY_HOME) == GLFW_PRESS) replay.seek(replay.startTime());
+    if (glfwGetKey(window, GLFW_KEY_END) == GLFW_PRESS)  replay.seek(replay.endTime());
+
+    float rate = replayPaused ? 0.0f : 1.0f;
+    if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS)  rate = -REPLAY_SCRUB_RATE;
+    if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS) rate = REPLAY_SCRUB_RATE;
+    if (rate != 0.0f) replay.advance(rate * deltaTime);
+}
+
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (key == GLFW_KEY_SPACE && action == GLFW_PRESS) replayPaused = !replayPaused;
+}
+
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn) {
     Camera* camera = static_cast<Camera*>(glfwGetWindowUserPointer(window));
     if (!camera) return;